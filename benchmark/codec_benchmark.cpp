@@ -0,0 +1,361 @@
+// ====================================================================
+// LightVoice: Codec Benchmark
+// benchmark/codec_benchmark.cpp
+//
+// Measures the signaling path of ProtobufCodec: the time and heap
+// allocations per control message as a batch of framed packets is
+// parsed out of an input Buffer. The codec's in-place, arena-backed
+// parse is compared with the copy-out path it replaced (retrieveAsString,
+// make_shared, ParseFromString). On the way out, serializing in place
+// into the output buffer is compared with the old string -> temporary
+// Buffer -> output buffer path. Binary media frames are timed both ways
+// as well, reporting their header overhead and checking that every
+// frame parses back to what was written. A room notification for 128
+// members is serialized per member and once for all. Finally a heartbeat
+// is taken through the PacketDispatcher inline and offloaded to a worker
+// pool, timed until its handler has run. Returns non-zero on a mismatch.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/PacketDispatcher.h"
+#include "codec/ProtobufCodec.h"
+#include "common/Logger.h"
+#include "pool/ThreadPool.h"
+#include "proto/chat.pb.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lightvoice;
+
+// --- Allocation counting ---
+// Replaces the global allocator so the benchmark can count every heap
+// allocation made while the counter is armed.
+static std::atomic<bool> g_countAllocs{false};
+static std::atomic<int64_t> g_allocCount{0};
+
+// Kept out of line so GCC does not pair the inlined malloc()/free() with
+// a library `new` expression and flag a mismatched deallocation.
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    if (g_countAllocs.load(std::memory_order_relaxed)) {
+        g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr int kBatch = 64;       // Messages per read, as in a login/join storm
+constexpr int kIterations = 5000;
+
+struct Result {
+    double nsPerMessage = 0;
+    double allocsPerMessage = 0;
+};
+
+// Appends `packet` to `buf` with the codec's 4-byte big-endian length.
+void appendFramed(net::Buffer& buf, const proto::Packet& packet) {
+    const std::string data = packet.SerializeAsString();
+    const uint32_t len = static_cast<uint32_t>(data.size());
+    const char header[4] = {static_cast<char>(len >> 24), static_cast<char>(len >> 16),
+                            static_cast<char>(len >> 8), static_cast<char>(len)};
+    buf.append(header, sizeof(header));
+    buf.append(data.data(), data.size());
+}
+
+// A mix of the messages a busy server sees most.
+std::vector<proto::Packet> makeBatch() {
+    std::vector<proto::Packet> batch(kBatch);
+    for (int i = 0; i < kBatch; ++i) {
+        switch (i % 3) {
+            case 0: batch[i].mutable_login_request()->set_username("listener_" + std::to_string(i)); break;
+            case 1: batch[i].mutable_join_room_request()->set_room_id(static_cast<uint32_t>(i)); break;
+            default: batch[i].mutable_send_text_request()->set_text("hello everyone in the lecture hall"); break;
+        }
+    }
+    return batch;
+}
+
+// The responses and notifications a server sends back.
+std::vector<proto::Packet> makeReplies() {
+    std::vector<proto::Packet> replies(kBatch);
+    for (int i = 0; i < kBatch; ++i) {
+        switch (i % 3) {
+            case 0: {
+                auto* response = replies[i].mutable_login_response();
+                response->set_success(true);
+                response->set_message("Welcome!");
+                response->set_user_id(static_cast<uint32_t>(1000 + i));
+                break;
+            }
+            case 1: {
+                auto* info = replies[i].mutable_join_room_response()->mutable_room_info();
+                info->set_room_id(static_cast<uint32_t>(i));
+                info->set_room_name("lecture hall");
+                info->set_member_count(120);
+                info->set_sample_rate(48000);
+                info->set_channels(1);
+                info->set_frame_duration_ms(20);
+                break;
+            }
+            default: {
+                auto* notification = replies[i].mutable_room_notification();
+                notification->set_user_id(static_cast<uint32_t>(i));
+                notification->set_username("listener_" + std::to_string(i));
+                notification->set_message("listener_" + std::to_string(i) + " has joined the room.");
+                break;
+            }
+        }
+    }
+    return replies;
+}
+
+// 20ms of 24kbps voice, an hour or so into a call.
+std::vector<MediaFramePtr> makeVoiceFrames() {
+    std::vector<MediaFramePtr> frames(kBatch);
+    for (int i = 0; i < kBatch; ++i) {
+        frames[i] = MediaFrame::acquire();
+        std::vector<unsigned char> payload(60, static_cast<unsigned char>(i));
+        frames[i]->assign(payload.data(), payload.size());
+        MediaFrame::Header& header = frames[i]->header();
+        header.sequence = 180000 + i;
+        header.timestamp = (180000 + i) * 960;
+        header.speakerId = 1000 + i % 8;
+        header.level = static_cast<uint8_t>(20 + i % 40);
+    }
+    return frames;
+}
+
+void appendMedia(net::Buffer& buf, const MediaFrame& frame) {
+    const size_t len = ProtobufCodec::mediaFrameSize(frame);
+    buf.ensureWritableBytes(len);
+    ProtobufCodec::writeMediaFrame(buf.beginWrite(), frame);
+    buf.hasWritten(len);
+}
+
+bool sameFrame(const MediaFrame& a, const MediaFrame& b) {
+    return a.size() == b.size() && std::equal(a.data(), a.data() + a.size(), b.data()) &&
+           a.header().sequence == b.header().sequence && a.header().timestamp == b.header().timestamp &&
+           a.header().speakerId == b.header().speakerId && a.header().level == b.header().level;
+}
+
+// Times `frame` writing every item into one output Buffer.
+template <typename Item, typename Frame>
+Result runSend(const std::vector<Item>& replies, Frame frame) {
+    net::Buffer output(64 * 1024);
+    int64_t allocs = 0;
+    double ns = 0;
+    for (int it = 0; it < kIterations; ++it) {
+        output.retrieveAll();
+        g_allocCount = 0;
+        g_countAllocs = true;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const Item& reply : replies) {
+            frame(reply, &output);
+        }
+        std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+        g_countAllocs = false;
+        ns += duration.count();
+        allocs += g_allocCount.load();
+    }
+    const double messages = static_cast<double>(kIterations) * kBatch;
+    return {ns / messages, static_cast<double>(allocs) / messages};
+}
+
+// Lets `fill` write a whole batch into a Buffer, then times `parse`
+// draining it.
+template <typename Fill, typename Parse>
+Result run(Fill fill, Parse parse) {
+    net::Buffer buf(64 * 1024);
+    int64_t allocs = 0;
+    double ns = 0;
+    for (int it = 0; it < kIterations; ++it) {
+        fill(buf);
+        g_allocCount = 0;
+        g_countAllocs = true;
+        auto start = std::chrono::high_resolution_clock::now();
+        parse(&buf);
+        std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+        g_countAllocs = false;
+        ns += duration.count();
+        allocs += g_allocCount.load();
+    }
+    const double messages = static_cast<double>(kIterations) * kBatch;
+    return {ns / messages, static_cast<double>(allocs) / messages};
+}
+
+} // namespace
+
+int main() {
+    Logger::Init();
+
+    const std::vector<proto::Packet> batch = makeBatch();
+    auto fillBatch = [&batch](net::Buffer& buf) {
+        for (const proto::Packet& packet : batch) {
+            appendFramed(buf, packet);
+        }
+    };
+    uint64_t seen = 0;
+
+    // The path ProtobufCodec::onMessage used to take.
+    Result copied = run(fillBatch, [&seen](net::Buffer* buf) {
+        while (buf->readableBytes() >= sizeof(int32_t)) {
+            const int32_t len = buf->peekInt32();
+            buf->retrieve(sizeof(int32_t));
+            std::string data = buf->retrieveAsString(len);
+            auto packet = std::make_shared<proto::Packet>();
+            if (packet->ParseFromString(data)) {
+                seen += packet->payload_case();
+            }
+        }
+    });
+
+    ProtobufCodec codec([&seen](const net::TcpConnectionPtr&, const proto::Packet& packet, Timestamp) {
+        seen += packet.payload_case();
+    });
+    const net::TcpConnectionPtr noConnection; // Only touched for malformed input
+    Result arena = run(fillBatch, [&](net::Buffer* buf) { codec.onMessage(noConnection, buf, Timestamp()); });
+
+    LOGGER_INFO("--- Codec Benchmark ({} messages per batch, {} batches) ---", kBatch, kIterations);
+    LOGGER_INFO("Parse {:<22} | {:>7.1f} ns/msg | {:>5.2f} allocs/msg", "copy + make_shared", copied.nsPerMessage,
+                copied.allocsPerMessage);
+    LOGGER_INFO("Parse {:<22} | {:>7.1f} ns/msg | {:>5.2f} allocs/msg | {:.2f}x", "in place + arena",
+                arena.nsPerMessage, arena.allocsPerMessage, copied.nsPerMessage / arena.nsPerMessage);
+
+    const std::vector<proto::Packet> replies = makeReplies();
+
+    // The path ProtobufCodec::send used to take.
+    Result copiedSend = runSend(replies, [](const proto::Packet& reply, net::Buffer* output) {
+        std::string data;
+        reply.SerializeToString(&data);
+        net::Buffer buf;
+        buf.append(data.c_str(), data.size());
+        const uint32_t len = static_cast<uint32_t>(data.size());
+        const uint32_t be32 = ((len & 0xFF) << 24) | ((len & 0xFF00) << 8) | ((len >> 8) & 0xFF00) | (len >> 24);
+        buf.prepend(&be32, sizeof(be32));
+        output->append(buf.peek(), buf.readableBytes());
+    });
+
+    // What TcpConnection::sendInPlace lets the codec do.
+    Result inPlaceSend = runSend(replies, [](const proto::Packet& reply, net::Buffer* output) {
+        const size_t bodyLen = reply.ByteSizeLong();
+        output->ensureWritableBytes(ProtobufCodec::kHeaderLen + bodyLen);
+        ProtobufCodec::writeFrame(output->beginWrite(), reply, bodyLen);
+        output->hasWritten(ProtobufCodec::kHeaderLen + bodyLen);
+    });
+
+    LOGGER_INFO("Send  {:<22} | {:>7.1f} ns/msg | {:>5.2f} allocs/msg", "string + temp Buffer", copiedSend.nsPerMessage,
+                copiedSend.allocsPerMessage);
+    LOGGER_INFO("Send  {:<22} | {:>7.1f} ns/msg | {:>5.2f} allocs/msg | {:.2f}x", "in place", inPlaceSend.nsPerMessage,
+                inPlaceSend.allocsPerMessage, copiedSend.nsPerMessage / inPlaceSend.nsPerMessage);
+
+    // Voice: binary media frames on the same stream.
+    const std::vector<MediaFramePtr> voice = makeVoiceFrames();
+    Result mediaSend = runSend(voice, [](const MediaFramePtr& frame, net::Buffer* output) {
+        appendMedia(*output, *frame);
+    });
+
+    size_t received = 0;
+    int mismatches = 0;
+    codec.setMediaFrameCallback([&](const net::TcpConnectionPtr&, MediaFramePtr frame, Timestamp) {
+        mismatches += !sameFrame(*frame, *voice[received++ % voice.size()]);
+    });
+    Result mediaParse = run(
+        [&voice](net::Buffer& buf) {
+            for (const MediaFramePtr& frame : voice) {
+                appendMedia(buf, *frame);
+            }
+        },
+        [&](net::Buffer* buf) { codec.onMessage(noConnection, buf, Timestamp()); });
+
+    const size_t headerBytes = ProtobufCodec::mediaFrameSize(*voice[0]) - voice[0]->size();
+    LOGGER_INFO("Media write                  | {:>7.1f} ns/frame | {:>5.2f} allocs/frame | {} header bytes",
+                mediaSend.nsPerMessage, mediaSend.allocsPerMessage, headerBytes);
+    LOGGER_INFO("Media parse                  | {:>7.1f} ns/frame | {:>5.2f} allocs/frame | {} of {} frames intact",
+                mediaParse.nsPerMessage, mediaParse.allocsPerMessage, received - mismatches, received);
+
+    // Broadcast: a join notification to a 128-member room, written into
+    // each member's output buffer.
+    constexpr int kMembers = 128;
+    std::vector<net::Buffer> outputs(kMembers);
+    const proto::Packet& notification = replies[2];
+    auto timeBroadcast = [&](auto deliver) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int it = 0; it < kIterations / 10; ++it) {
+            for (net::Buffer& output : outputs) {
+                output.retrieveAll();
+            }
+            deliver();
+        }
+        std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+        return duration.count() / (kIterations / 10);
+    };
+    const double perMemberNs = timeBroadcast([&] {
+        for (net::Buffer& output : outputs) {
+            const size_t bodyLen = notification.ByteSizeLong();
+            output.ensureWritableBytes(ProtobufCodec::kHeaderLen + bodyLen);
+            ProtobufCodec::writeFrame(output.beginWrite(), notification, bodyLen);
+            output.hasWritten(ProtobufCodec::kHeaderLen + bodyLen);
+        }
+    });
+    const double onceNs = timeBroadcast([&] {
+        const size_t bodyLen = notification.ByteSizeLong();
+        auto payload = std::make_shared<std::string>(ProtobufCodec::kHeaderLen + bodyLen, '\0');
+        ProtobufCodec::writeFrame(payload->data(), notification, bodyLen);
+        for (net::Buffer& output : outputs) {
+            output.append(payload->data(), payload->size());
+        }
+    });
+    LOGGER_INFO("Broadcast to {} per member   | {:>7.0f} ns", kMembers, perMemberNs);
+    LOGGER_INFO("Broadcast to {} once         | {:>7.0f} ns | {:.2f}x", kMembers, onceNs, perMemberNs / onceNs);
+
+    // Dispatch: the same heartbeat handled on this thread, or handed to a
+    // worker and waited for.
+    ThreadPool workers(1);
+    PacketDispatcher dispatcher(&workers);
+    std::atomic<int> handled{0};
+    auto onHeartbeat = [&handled](const net::TcpConnectionPtr&, const proto::Packet&, Timestamp) {
+        handled.fetch_add(1, std::memory_order_release);
+    };
+    proto::Packet heartbeat;
+    heartbeat.mutable_heartbeat()->set_timestamp(1234567);
+    auto timeDispatch = [&](int messages) {
+        handled = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < messages; ++i) {
+            dispatcher.dispatch(noConnection, heartbeat, Timestamp());
+            while (handled.load(std::memory_order_acquire) <= i) {
+                std::this_thread::yield();
+            }
+        }
+        std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+        return duration.count() / messages;
+    };
+    dispatcher.registerInline(proto::Packet::kHeartbeat, onHeartbeat);
+    const double inlineNs = timeDispatch(100000);
+    dispatcher.registerOffloaded(proto::Packet::kHeartbeat, onHeartbeat);
+    const double offloadedNs = timeDispatch(20000);
+    LOGGER_INFO("Dispatch inline              | {:>7.1f} ns/msg", inlineNs);
+    LOGGER_INFO("Dispatch offloaded to pool   | {:>7.1f} ns/msg | {:.0f}x the inline cost", offloadedNs,
+                offloadedNs / inlineNs);
+    LOGGER_INFO("(checksum {})", seen);
+
+    if (mismatches != 0 || received != static_cast<size_t>(kIterations) * kBatch) {
+        LOGGER_ERROR("FAILED: media frames did not survive the round trip");
+        return 1;
+    }
+    return 0;
+}
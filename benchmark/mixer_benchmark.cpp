@@ -2,61 +2,605 @@
 // LightVoice: Mixer Benchmark
 // benchmark/mixer_benchmark.cpp
 //
-// A benchmark to test the performance of the AudioMixer.
+// Times a mix tick, from the SpeakerTable's packets to the AudioMixer's
+// encoded tiers, for 2 to 16 speakers talking in words and pauses. The
+// other sections vary one thing at a time: sample rate, frame duration,
+// number of bitrate tiers, frames bundled per packet, where decoding
+// happens, serial or forked tier encodes, and a single speaker's packet
+// forwarded instead of re-encoded. An idle room and a room of open
+// microphones show what the silence detection and the VAD leave out,
+// and the mix kernel is timed and checked against a plain division.
+//
+// With --count-allocs it exits non-zero if a steady-state tick
+// allocates on the heap.
 //
 // Author: Gemini
 // ====================================================================
 
+#include "codec/AudioConfig.h"
 #include "codec/AudioMixer.h"
+#include "codec/FrameBundler.h"
+#include "codec/IngressDecoder.h"
+#include "codec/MediaFrame.h"
+#include "codec/MixKernels.h"
 #include "codec/OpusEncoder.h"
+#include "codec/OpusStatePool.h"
 #include "common/Logger.h"
+#include "pool/ThreadPool.h"
+#include "room/SpeakerTable.h"
+#include <fmt/ranges.h>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <iterator>
 #include <numeric>
+#include <random>
 
 using namespace lightvoice;
 
-// Create a dummy silent Opus frame
-AudioFramePtr create_silent_frame(OpusEncoder& encoder) {
-    std::vector<int16_t> pcm(960, 0);
-    auto frame = std::make_shared<AudioFrame>();
-    encoder.encode(pcm, *frame);
+// --- Allocation counting ---
+// Replaces the global allocator so the benchmark can count every heap
+// allocation made while the counter is armed.
+static std::atomic<bool> g_countAllocs{false};
+static std::atomic<int64_t> g_allocCount{0};
+
+void* operator new(std::size_t size) {
+    if (g_countAllocs.load(std::memory_order_relaxed)) {
+        g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Kept out of line so GCC does not pair the inlined free() with a
+// library `new` expression and flag a mismatched deallocation.
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Create an Opus frame of low-level background noise (amplitude ~10,
+// around -70dBov) from a fresh encoder, so no earlier audio leaks in
+MediaFramePtr create_noise_frame(const AudioConfig& config, int amplitude) {
+    lightvoice::OpusEncoder encoder(config.sampleRate, config.channels, config.frameSize());
+    std::vector<int16_t> pcm(static_cast<size_t>(config.frameSize()) * config.channels);
+    unsigned int seed = 1;
+    for (auto& sample : pcm) {
+        seed = seed * 1103515245u + 12345u;
+        sample = static_cast<int16_t>(static_cast<int>((seed >> 16) % (2 * amplitude + 1)) - amplitude);
+    }
+    MediaFramePtr frame = MediaFrame::acquire();
+    frame->setSize(encoder.encode(pcm.data(), frame->data(), static_cast<int>(MediaFrame::capacity())));
     return frame;
 }
 
-int main() {
+// Create an Opus frame carrying a tone, so decode and encode do real work.
+// `index` is the frame's position in the tone, which stays continuous
+// across frames.
+MediaFramePtr create_tone_frame(lightvoice::OpusEncoder& encoder, const AudioConfig& config, double freq,
+                                int index = 0, double amplitude = 6000.0) {
+    std::vector<int16_t> pcm(static_cast<size_t>(config.frameSize()) * config.channels);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        double t = static_cast<double>(static_cast<size_t>(index) * config.frameSize() + i / config.channels) /
+                   config.sampleRate;
+        pcm[i] = static_cast<int16_t>(amplitude * std::sin(2.0 * M_PI * freq * t));
+    }
+    MediaFramePtr frame = MediaFrame::acquire();
+    frame->setSize(encoder.encode(pcm.data(), frame->data(), static_cast<int>(MediaFrame::capacity())));
+    return frame;
+}
+
+// Speakers saying a tone in words of kWordMs with kPauseMs pauses, one
+// packet each per tick. A tone that never pauses would be a hum to the
+// VAD, which learns it as noise within its window and gates it out.
+// Open mics added with addOpenMic() send the same packet every tick.
+class Talkers {
+public:
+    static constexpr int kWordMs = 300;
+    static constexpr int kPauseMs = 100;
+
+    Talkers(const AudioConfig& config, int speakers, double base_freq = 220.0, double step = 110.0) {
+        const int word = std::max(1, kWordMs / config.frameDurationMs);
+        const int pause = std::max(1, kPauseMs / config.frameDurationMs);
+        ticks_.resize(static_cast<size_t>(word + pause));
+        for (int s = 0; s < speakers; ++s) {
+            lightvoice::OpusEncoder encoder(config.sampleRate, config.channels, config.frameSize());
+            for (int k = 0; k < word + pause; ++k) {
+                MediaFramePtr frame = create_tone_frame(encoder, config, base_freq + step * s, k, k < word ? 6000.0 : 0.0);
+                frame->header().speakerId = static_cast<uint32_t>(s + 1);
+                ticks_[static_cast<size_t>(k)].push_back(std::move(frame));
+            }
+        }
+    }
+
+    void addOpenMic(MediaFramePtr frame) {
+        for (auto& tick : ticks_) {
+            tick.push_back(frame);
+        }
+    }
+
+    // Every speaker's packet for the given tick.
+    const std::vector<MediaFramePtr>& at(int tick) const { return ticks_[static_cast<size_t>(tick) % ticks_.size()]; }
+
+private:
+    std::vector<std::vector<MediaFramePtr>> ticks_;
+};
+
+// One room's mixer side, driven the way VoiceRoom::onMixTimer drives
+// it: every speaker's packet goes through the SpeakerTable (decoded with
+// that speaker's own decoder) and the collected PCM is mixed for every
+// tier in the mask.
+struct MixRoom {
+    explicit MixRoom(const AudioConfig& config)
+        : table(config), mixer(config.sampleRate, config.channels, config.frameSize()) {
+        sources.reserve(SpeakerTable::kSlots);
+    }
+
+    // One tick, with one packet from each frame's speaker.
+    size_t tick(const std::vector<MediaFramePtr>& frames, uint32_t tierMask) {
+        for (const MediaFramePtr& frame : frames) {
+            table.push(frame->header().speakerId, frame);
+        }
+        table.collect(sources);
+        const size_t tiers = mixer.mixDecoded(sources, tierMask, out);
+        table.advance();
+        sources.clear();
+        return tiers;
+    }
+
+    SpeakerTable table;
+    AudioMixer mixer;
+    std::vector<AudioMixer::PcmSource> sources;
+    AudioMixer::TierFrames out;
+};
+
+// Compares the cost of one mix tick across the per-room sample rate tiers.
+void run_rate_tiers(int speakers, int iterations) {
+    const opus_int32 rates[] = {8000, 16000, 24000, 48000};
+    double avg_ms[std::size(rates)];
+
+    LOGGER_INFO("--- Sample rate tiers ({} speakers, 20ms, mono) ---", speakers);
+    for (size_t r = 0; r < std::size(rates); ++r) {
+        AudioConfig config;
+        config.sampleRate = rates[r];
+
+        MixRoom room(config);
+        const Talkers talkers(config, speakers);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            room.tick(talkers.at(i), 1u);
+        }
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+        avg_ms[r] = duration.count() / iterations;
+    }
+
+    const double full_band = avg_ms[std::size(rates) - 1];
+    for (size_t r = 0; r < std::size(rates); ++r) {
+        LOGGER_INFO("Rate: {:>5} Hz | Avg time per mix: {:<8.4f} ms | {:>5.1f}% of 48kHz cost",
+                    rates[r], avg_ms[r], 100.0 * avg_ms[r] / full_band);
+    }
+}
+
+// Compares frame durations for one room: packets/s per listener, wire
+// bitrate including per-packet overhead, and mixer CPU per second of audio.
+void run_frame_durations(int speakers, int seconds) {
+    // IPv4 + TCP headers plus the 4 byte length prefix of our framing.
+    constexpr int kPacketOverheadBytes = 20 + 20 + 4;
+    const int durations[] = {10, 20, 40, 60};
+
+    LOGGER_INFO("--- Frame durations ({} speakers, 48kHz mono) ---", speakers);
+    for (int ms : durations) {
+        AudioConfig config;
+        config.frameDurationMs = ms;
+
+        MixRoom room(config);
+        const Talkers talkers(config, speakers);
+
+        const int ticks = seconds * 1000 / ms;
+        size_t payload_bytes = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < ticks; ++i) {
+            if (room.tick(talkers.at(i), 1u) > 0) {
+                payload_bytes += room.out[0]->size();
+            }
+        }
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+        const double packets_per_sec = 1000.0 / ms;
+        const double payload_kbps = payload_bytes * 8.0 / seconds / 1000.0;
+        const double wire_kbps = payload_kbps + packets_per_sec * kPacketOverheadBytes * 8.0 / 1000.0;
+        LOGGER_INFO("ptime: {:>2} ms | {:>5.1f} packets/s | payload {:>5.1f} kbps | wire {:>5.1f} kbps | "
+                    "CPU {:>6.2f} ms per second of audio",
+                    ms, packets_per_sec, payload_kbps, wire_kbps, duration.count() / seconds);
+    }
+}
+
+// Cost of encoding the mix for 1, 2 and 3 bitrate tiers. The cost
+// depends only on the number of tiers, never on the number of listeners.
+void run_bitrate_ladder(int speakers, int iterations) {
+    AudioConfig config;
+    MixRoom room(config);
+    const Talkers talkers(config, speakers);
+
+    LOGGER_INFO("--- Bitrate ladder ({} speakers) ---", speakers);
+    const AudioMixer::TierFrames& out = room.out;
+    for (int tiers = 1; tiers <= AudioMixer::kMaxTiers; ++tiers) {
+        const uint32_t mask = (1u << tiers) - 1;
+        room.tick(talkers.at(0), mask); // Creates the tier encoders
+
+        size_t bytes[AudioMixer::kMaxTiers] = {};
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            room.tick(talkers.at(i), mask);
+            for (int t = 0; t < tiers; ++t) {
+                bytes[t] += out[t] ? out[t]->size() : 0;
+            }
+        }
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+        for (size_t& b : bytes) {
+            b /= static_cast<size_t>(iterations);
+        }
+        LOGGER_INFO("Tiers: {} | Avg time per mix: {:<8.4f} ms | bytes per packet: {}", tiers,
+                    duration.count() / iterations,
+                    fmt::join(bytes, bytes + tiers, " / "));
+    }
+}
+
+// Feeds one room's mixed stream to listeners bundling 1, 2 and 3 frames
+// per packet and counts what each would send.
+void run_frame_bundling(int ticks) {
+    AudioConfig config;
+    MixRoom room(config);
+    const Talkers talker(config, 1, 440.0);
+
+    FrameBundler bundle2(2, config.sampleRate);
+    FrameBundler bundle3(3, config.sampleRate);
+    FrameBundler* bundlers[] = {nullptr, &bundle2, &bundle3};
+    size_t packets[3] = {}, bytes[3] = {};
+    std::chrono::duration<double, std::micro> bundling_time[3] = {};
+
+    for (int i = 0; i < ticks; ++i) {
+        if (room.tick(talker.at(i), 1u) == 0) {
+            continue;
+        }
+        const MediaFramePtr& mixed = room.out[0];
+        for (int b = 0; b < 3; ++b) {
+            auto start = std::chrono::high_resolution_clock::now();
+            MediaFramePtr packet = bundlers[b] ? bundlers[b]->push(mixed) : mixed;
+            bundling_time[b] += std::chrono::high_resolution_clock::now() - start;
+            if (packet) {
+                ++packets[b];
+                bytes[b] += packet->size();
+            }
+        }
+    }
+
+    LOGGER_INFO("--- Frame bundling ({} ticks of 20ms) ---", ticks);
+    for (int b = 0; b < 3; ++b) {
+        LOGGER_INFO("Frames per packet: {} | packets: {:>5} ({:.2f}x fewer) | payload bytes: {:>7} | "
+                    "bundling cost: {:.3f} us per frame",
+                    b + 1, packets[b], static_cast<double>(packets[0]) / packets[b], bytes[b],
+                    bundling_time[b].count() / ticks);
+    }
+}
+
+// Mixer-thread cost per tick with the SpeakerTable decoding on the
+// mixer thread and decoding on ingress. The pushes (and so the ingress
+// decodes) run inline here but are timed separately: in the server they
+// are spread over the IO threads.
+void run_decode_on_ingress(int speakers, int iterations) {
+    AudioConfig config;
+    const Talkers talkers(config, speakers);
+
+    LOGGER_INFO("--- Decode on ingress ({} speakers) ---", speakers);
+    for (bool on_ingress : {false, true}) {
+        config.decodeOnIngress = on_ingress;
+        MixRoom room(config);
+        std::chrono::duration<double, std::milli> io_threads{0}, mixer_thread{0};
+        for (int i = 0; i < iterations; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (const MediaFramePtr& frame : talkers.at(i)) {
+                room.table.push(frame->header().speakerId, frame);
+            }
+            auto pushed = std::chrono::high_resolution_clock::now();
+            io_threads += pushed - start;
+
+            room.tick({}, 1u);
+            mixer_thread += std::chrono::high_resolution_clock::now() - pushed;
+        }
+        LOGGER_INFO("{:<15} {:.4f} ms per tick on the mixer thread (+{:.4f} ms spread over IO threads)",
+                    on_ingress ? "Ingress decode:" : "Mixer decodes:", mixer_thread.count() / iterations,
+                    io_threads.count() / iterations);
+    }
+}
+
+// The sum/clip loop the mixer used before its kernel, with a per-sample
+// integer division.
+int64_t mix_with_division(const int16_t* const* sources, size_t count, int32_t* accum, int16_t* out,
+                          size_t samples) {
+    std::copy(sources[0], sources[0] + samples, accum);
+    for (size_t s = 1; s < count; ++s) {
+        for (size_t i = 0; i < samples; ++i) {
+            accum[i] += sources[s][i];
+        }
+    }
+    const int32_t divisor = count > 2 ? static_cast<int32_t>(count / 2) : 1;
+    int64_t energy = 0;
+    for (size_t i = 0; i < samples; ++i) {
+        int32_t sample = std::clamp(accum[i] / divisor, -32768, 32767);
+        out[i] = static_cast<int16_t>(sample);
+        energy += static_cast<int64_t>(sample) * sample;
+    }
+    return energy;
+}
+
+// Sum/clip cost per call of the mix kernel against the division loop, on
+// random PCM for the common frame lengths, for a 2-source mix (no
+// scaling) and an 8-source one (scaled down).
+void run_mix_kernels(int iterations) {
+    struct Layout { int channels; int frame_size; };
+    const Layout layouts[] = {{1, 480}, {1, 960}, {1, 1920}, {2, 480}, {2, 960}, {2, 1920}};
+    const size_t max_sources = 8;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(-20000, 20000);
+
+    LOGGER_INFO("--- Mix kernels ({} calls each) ---", iterations * 10);
+    for (const Layout& layout : layouts) {
+        const size_t samples = static_cast<size_t>(layout.frame_size) * layout.channels;
+        std::vector<std::vector<int16_t>> pcm(max_sources, std::vector<int16_t>(samples));
+        std::vector<const int16_t*> sources;
+        for (auto& source : pcm) {
+            for (int16_t& sample : source) {
+                sample = static_cast<int16_t>(dist(rng));
+            }
+            sources.push_back(source.data());
+        }
+        std::vector<int32_t> accum(samples);
+        std::vector<int16_t> division_out(samples), kernel_out(samples);
+
+        using Kernel = int64_t (*)(const int16_t* const*, size_t, int32_t*, int16_t*, size_t);
+        const Kernel kernels[] = {&mix_with_division, &mixSources};
+        for (size_t count : {size_t(2), max_sources}) {
+            double ns[2];
+            int64_t energy[2];
+            int16_t* outs[2] = {division_out.data(), kernel_out.data()};
+            for (int k = 0; k < 2; ++k) {
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < iterations * 10; ++i) {
+                    energy[k] = kernels[k](sources.data(), count, accum.data(), outs[k], samples);
+                }
+                std::chrono::duration<double, std::nano> duration = std::chrono::high_resolution_clock::now() - start;
+                ns[k] = duration.count() / (iterations * 10);
+            }
+            const bool identical = energy[0] == energy[1] && division_out == kernel_out;
+            LOGGER_INFO("{}ch x {:<4} | {} sources | division: {:>8.1f} ns | kernel: {:>8.1f} ns | {:.2f}x | identical: {}",
+                        layout.channels, layout.frame_size, count, ns[0], ns[1], ns[0] / ns[1],
+                        identical ? "yes" : "NO");
+        }
+    }
+}
+
+void run_pass_through(int iterations) {
+    AudioConfig config;
+    const Talkers talker(config, 1, 330.0);
+    IngressDecoder decoder(1, config.sampleRate, config.channels, config.frameSize());
+
+    LOGGER_INFO("--- Single-speaker pass-through ---");
+    for (bool pass_through : {false, true}) {
+        AudioMixer mixer(config.sampleRate, config.channels, config.frameSize());
+        mixer.setPassThrough(pass_through);
+        std::vector<AudioMixer::PcmSource> sources;
+        AudioMixer::TierFrames out;
+        size_t bytes = 0;
+        std::chrono::duration<double, std::milli> mixer_time{0};
+        for (int i = 0; i < iterations; ++i) {
+            decoder.decode(talker.at(i)[0]);
+            const IngressDecoder::PcmFrame* frame = decoder.front();
+            sources.push_back({1, frame->pcm.data(), frame->packet.get()});
+
+            auto start = std::chrono::high_resolution_clock::now();
+            mixer.mixDecoded(sources, 1u, out);
+            mixer_time += std::chrono::high_resolution_clock::now() - start;
+
+            bytes += out[0] ? out[0]->size() : 0;
+            decoder.pop();
+            sources.clear();
+        }
+        LOGGER_INFO("{:<13} | Avg time per tick: {:<8.4f} ms | passed through: {}/{} | bytes per packet: {}",
+                    pass_through ? "pass-through" : "re-encode", mixer_time.count() / iterations,
+                    mixer.stats().passThroughs, iterations, bytes / static_cast<size_t>(iterations));
+    }
+}
+
+// Mixer-thread cost of a full bitrate-ladder tick with the tier encodes
+// run serially, always forked onto an encode pool, and forked only when
+// the mixer's measured encode cost calls for it.
+void run_parallel_encodes(int speakers, int iterations) {
+    AudioConfig config;
+    const Talkers talkers(config, speakers);
+
+    ThreadPool pool(AudioMixer::kMaxTiers - 1);
+    const uint32_t mask = (1u << AudioMixer::kMaxTiers) - 1;
+    const char* modes[] = {"serial", "forked", "adaptive"};
+
+    LOGGER_INFO("--- Parallel encodes ({} speakers, {} tiers) ---", speakers, AudioMixer::kMaxTiers);
+    for (int m = 0; m < 3; ++m) {
+        MixRoom room(config);
+        if (m > 0) {
+            room.mixer.setEncodePool(&pool);
+        }
+        if (m == 1) {
+            room.mixer.setParallelEncodeThreshold(0);
+        }
+        room.tick(talkers.at(0), mask); // Creates the tier encoders
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            room.tick(talkers.at(i), mask);
+        }
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+        const AudioMixer::Stats& stats = room.mixer.stats();
+        LOGGER_INFO("{:<8} | Avg time per tick: {:<8.4f} ms | forked ticks: {} | encodes taken back: {}", modes[m],
+                    duration.count() / iterations, stats.parallelTicks, stats.reclaimedEncodes);
+    }
+}
+
+// Simulates a mostly idle room: a short burst of speech, then quiet
+// background frames from one speaker and ticks with nothing at all.
+// Reports the fraction of encodes skipped and the cost per tick.
+void run_idle_room(int ticks) {
+    AudioConfig config;
+    MixRoom room(config);
+    const Talkers speech(config, 1, 440.0);
+    const std::vector<MediaFramePtr> quiet = {create_noise_frame(config, 10)};
+    const std::vector<MediaFramePtr> nothing;
+    quiet[0]->header().speakerId = 1;
+
+    size_t packets = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ticks; ++i) {
+        // 10% speech, then alternating quiet frames and empty ticks.
+        const auto& frames = i < ticks / 10 ? speech.at(i) : (i % 2 ? quiet : nothing);
+        if (room.tick(frames, 1u) > 0) {
+            ++packets;
+        }
+    }
+    std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+    const AudioMixer::Stats& stats = room.mixer.stats();
+    LOGGER_INFO("--- Idle room ({} ticks, 10% speech) ---", ticks);
+    LOGGER_INFO("Encodes: {} | Skipped: {} ({:.1f}%) | Comfort noise: {} | Packets sent: {}",
+                stats.encodes, stats.skippedEncodes, 100.0 * stats.skippedRatio(),
+                stats.comfortNoiseFrames, packets);
+    LOGGER_INFO("Avg time per tick: {:.4f} ms", duration.count() / ticks);
+}
+
+// A busy room: a few real speakers plus many open microphones picking
+// up background noise (amplitude ~300, around -40dBov). The VAD should
+// keep only the speakers in the mix.
+void run_busy_room(int speakers, int open_mics, int ticks) {
+    AudioConfig config;
+    MixRoom room(config);
+    Talkers talkers(config, speakers);
+    for (int m = 0; m < open_mics; ++m) {
+        MediaFramePtr frame = create_noise_frame(config, 300);
+        frame->header().speakerId = static_cast<uint32_t>(speakers + m + 1);
+        talkers.addOpenMic(std::move(frame));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ticks; ++i) {
+        room.tick(talkers.at(i), 1u);
+    }
+    std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+    uint32_t dominant[3];
+    const size_t num_dominant = room.mixer.dominantSpeakers(dominant, std::size(dominant));
+    const AudioMixer::Stats& stats = room.mixer.stats();
+    LOGGER_INFO("--- Busy room ({} speakers, {} open mics) ---", speakers, open_mics);
+    LOGGER_INFO("Gated sources per tick: {:.1f} | Dominant speakers: {} | Avg time per tick: {:.4f} ms",
+                static_cast<double>(stats.gatedSources) / ticks,
+                fmt::join(dominant, dominant + num_dominant, ","), duration.count() / ticks);
+}
+
+// Runs `ticks` steady-state production ticks (every tier of the ladder)
+// with the allocation counter armed, and returns the allocations seen.
+// Each tier frame comes from the MediaFrame pool, as in VoiceRoom. With
+// a pool, every tick forks its tier encodes onto it.
+int64_t count_mix_allocations(const AudioConfig& config, const Talkers& talkers, int ticks,
+                              ThreadPool* pool = nullptr) {
+    const uint32_t mask = (1u << AudioMixer::kMaxTiers) - 1;
+    MixRoom room(config);
+    if (pool) {
+        room.mixer.setEncodePool(pool);
+        room.mixer.setParallelEncodeThreshold(0);
+    }
+    // Warm-up: the speakers take their slots and the tier encoders are
+    // created.
+    for (int i = 0; i < 3; ++i) {
+        room.tick(talkers.at(i), mask);
+    }
+
+    g_allocCount = 0;
+    g_countAllocs = true;
+    for (int i = 0; i < ticks; ++i) {
+        room.tick(talkers.at(i), mask);
+    }
+    g_countAllocs = false;
+    return g_allocCount.load();
+}
+
+int main(int argc, char* argv[]) {
     Logger::Init();
 
-    const int sample_rate = 48000;
-    const int channels = 1;
-    const int frame_size = 960; // 20ms
+    const bool count_allocs = argc > 1 && std::strcmp(argv[1], "--count-allocs") == 0;
+
+    OpusStatePool::instance().prewarm(8, 2 * SpeakerTable::kSlots);
 
-    AudioMixer mixer(sample_rate, channels, frame_size);
-    OpusEncoder encoder(sample_rate, channels, frame_size);
-    
-    auto silent_frame = create_silent_frame(encoder);
+    // Silent frames would be skipped by the silence detection, so the
+    // speaker sweep mixes real tones (48kHz mono, 20ms).
+    AudioConfig config;
+    MixRoom room(config);
+    ThreadPool encode_pool(AudioMixer::kMaxTiers - 1);
 
-    const int num_speakers[] = {2, 4, 8, 16, 32};
+    // Up to the most speakers a room mixes at once.
+    const int num_speakers[] = {2, 4, 8, 16};
     const int iterations = 1000;
+    bool allocation_free = true;
 
     LOGGER_INFO("--- AudioMixer Benchmark ---");
-    LOGGER_INFO("Sample Rate: {}, Frame Size: {}", sample_rate, frame_size);
+    LOGGER_INFO("Sample Rate: {}, Frame Size: {}", config.sampleRate, config.frameSize());
     LOGGER_INFO("Iterations per test: {}", iterations);
 
     for (int speakers : num_speakers) {
-        std::vector<AudioFramePtr> frames(speakers, silent_frame);
-        
+        const Talkers talkers(config, speakers, 220.0, 55.0);
+
         auto start = std::chrono::high_resolution_clock::now();
 
         for (int i = 0; i < iterations; ++i) {
-            AudioFramePtr mixed_frame = mixer.mix(frames);
+            room.tick(talkers.at(i), 1u);
         }
 
         auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double, std::milli> duration = end - start;
-        
+
         double avg_time = duration.count() / iterations;
         LOGGER_INFO("Speakers: {:<4} | Avg time per mix: {:<8.4f} ms", speakers, avg_time);
+
+        if (count_allocs) {
+            const int64_t allocs = count_mix_allocations(config, talkers, iterations);
+            const int64_t forked_allocs = count_mix_allocations(config, talkers, iterations, &encode_pool);
+            LOGGER_INFO("Speakers: {:<4} | Allocations per tick: {:.3f} serial, {:.3f} forked ({} + {} in {} ticks)",
+                        speakers, static_cast<double>(allocs) / iterations,
+                        static_cast<double>(forked_allocs) / iterations, allocs, forked_allocs, iterations);
+            if (allocs != 0 || forked_allocs != 0) {
+                allocation_free = false;
+            }
+        }
     }
-    
+
+    run_rate_tiers(8, iterations);
+    run_idle_room(iterations);
+    run_busy_room(4, 12, iterations);
+    run_frame_durations(8, 10);
+    run_bitrate_ladder(8, iterations);
+    run_frame_bundling(iterations);
+    run_decode_on_ingress(8, iterations);
+    run_parallel_encodes(8, iterations);
+    run_pass_through(iterations);
+    run_mix_kernels(iterations);
+
+    if (count_allocs && !allocation_free) {
+        LOGGER_ERROR("FAILED: steady-state mix tick performed heap allocations");
+        return 1;
+    }
+
     return 0;
 }
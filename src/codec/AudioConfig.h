@@ -0,0 +1,52 @@
+// ====================================================================
+// LightVoice: Audio Config
+// src/codec/AudioConfig.h
+//
+// Per-room audio parameters: sample rate, channel count and frame
+// duration. The room's mixer, decoders and encoder are all created
+// with these, so a narrowband room decodes, mixes and encodes at its
+// own (lower) rate end to end.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include <opus/opus_types.h>
+
+namespace lightvoice {
+
+struct AudioConfig {
+    opus_int32 sampleRate = 48000;
+    int channels = 1;
+    int frameDurationMs = 20;
+    // Decode each speaker's packets on the IO thread that received them
+    // (one decoder per speaker), so the mixer thread only sums and
+    // encodes. When false the mixer decodes every source itself.
+    bool decodeOnIngress = true;
+    // While exactly one speaker is audible, forward their own Opus
+    // packet instead of re-encoding a mix of one (see AudioMixer).
+    bool passThrough = true;
+
+    // Samples per channel in one frame, e.g. 960 for 20ms at 48kHz.
+    int frameSize() const { return static_cast<int>(sampleRate / 1000 * frameDurationMs); }
+
+    // Sample rates Opus can decode to and encode from natively.
+    static bool isSupportedSampleRate(opus_int32 rate) {
+        return rate == 8000 || rate == 12000 || rate == 16000 || rate == 24000 || rate == 48000;
+    }
+
+    // Opus frame sizes the mix scheduler can tick at. 10ms suits
+    // low-latency rooms; 40/60ms cut packets/s for large broadcasts.
+    static bool isSupportedFrameDuration(int ms) {
+        return ms == 10 || ms == 20 || ms == 40 || ms == 60;
+    }
+
+    bool valid() const {
+        return isSupportedSampleRate(sampleRate) &&
+               (channels == 1 || channels == 2) &&
+               isSupportedFrameDuration(frameDurationMs);
+    }
+};
+
+} // namespace lightvoice
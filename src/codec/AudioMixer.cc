@@ -8,75 +8,400 @@
 // ====================================================================
 
 #include "codec/AudioMixer.h"
-#include "codec/OpusDecoder.h"
 #include "codec/OpusEncoder.h"
+#include "codec/SampleOps.h"
 #include "common/Logger.h"
+#include "pool/ThreadPool.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <numeric>
 
 namespace lightvoice {
 
+namespace {
+
+// RFC 6464 style audio level: RMS in -dBov, 0 (full scale) to 127 (silence).
+uint8_t levelFromEnergy(int64_t energy, size_t samples) {
+    if (energy == 0 || samples == 0) {
+        return 127;
+    }
+    double rms = std::sqrt(static_cast<double>(energy) / static_cast<double>(samples)) / 32768.0;
+    double dbov = -20.0 * std::log10(rms);
+    return static_cast<uint8_t>(std::clamp(dbov, 0.0, 127.0));
+}
+
+} // namespace
+
 AudioMixer::AudioMixer(opus_int32 sample_rate, int channels, int frame_size)
     : sample_rate_(sample_rate),
       channels_(channels),
       frame_size_(frame_size),
-      decoder_(std::make_unique<OpusDecoder>(sample_rate, channels)),
-      encoder_(std::make_unique<OpusEncoder>(sample_rate, channels, frame_size)) {
-    
-    mix_buffer_.resize(frame_size_ * channels_);
+      frame_ms_(static_cast<int>(frame_size * 1000 / sample_rate)),
+      samples_per_frame_(static_cast<size_t>(frame_size) * channels),
+      comfort_noise_interval_ticks_(static_cast<uint32_t>(std::max(1, kComfortNoiseIntervalMs / std::max(1, frame_ms_)))),
+      speaker_idle_ticks_(static_cast<uint64_t>(kSpeakerIdleMs / std::max(1, frame_ms_))) {
+
+    const opus_int32 full = OpusEncoder::defaultBitrate(sample_rate);
+    tier_bitrates_ = {full, full / 2, std::max<opus_int32>(6000, full / 4)};
+    encoders_[0] = std::make_unique<OpusEncoder>(sample_rate, channels, frame_size);
+
+    pcm_slots_.resize(kDefaultSourceSlots * samples_per_frame_);
+    sources_.reserve(kDefaultSourceSlots);
+    speakers_.reserve(kMaxSpeakerStates);
+    accum_.resize(samples_per_frame_);
+    mix_buffer_.resize(samples_per_frame_);
+    parallel_threshold_us_ = static_cast<int64_t>(frame_ms_) * 1000 * kParallelEncodePercent / 100;
 }
 
 AudioMixer::~AudioMixer() = default;
 
-AudioFramePtr AudioMixer::mix(const std::vector<AudioFramePtr>& frames) {
-    if (frames.empty()) {
-        return nullptr;
+bool AudioMixer::mixPcm(const std::vector<PcmSource>& sources) {
+    ++stats_.ticks;
+
+    // Gained sources need a slot of their own: the decoded PCM belongs
+    // to the speaker's slot.
+    if (sources.size() * samples_per_frame_ > pcm_slots_.size()) {
+        LOGGER_DEBUG("AudioMixer: growing PCM slots to {} sources", sources.size());
+        pcm_slots_.resize(sources.size() * samples_per_frame_);
     }
 
-    std::fill(mix_buffer_.begin(), mix_buffer_.end(), 0);
-    std::vector<std::vector<int16_t>> decoded_pcms;
-    decoded_pcms.reserve(frames.size());
+    // 1. Each speaker's own decoder has already run; the VAD gates the
+    // frames that are not speech out of the sum.
+    sources_.clear();
+    lone_packet_ = nullptr;
+    for (const PcmSource& source : sources) {
+        SpeakerState& speaker = speakerFor(source.speakerId);
+        if (!speaker.vad.process(source.pcm, samples_per_frame_, channels_)) {
+            ++stats_.gatedSources;
+            continue;
+        }
+        const bool unity = speaker.gain == 1.0f && speaker.appliedGain == 1.0f;
+        sources_.push_back(applyGain(speaker, source.pcm, pcmSlot(sources_.size())));
+        lone_packet_ = unity ? source.packet : nullptr;
+        lone_speaker_ = speaker.speakerId;
+    }
+    return sumSources();
+}
 
-    // 1. Decode all frames
-    for (const auto& frame : frames) {
-        std::vector<int16_t> pcm_buffer;
-        int decoded_samples = decoder_->decode(*frame, pcm_buffer, frame_size_);
-        if (decoded_samples == frame_size_) {
-            decoded_pcms.push_back(std::move(pcm_buffer));
+bool AudioMixer::sumSources() {
+    if (sources_.empty()) {
+        mix_level_ = 127;
+    } else {
+        // 2. Mix (additive) and 3. clip, in one kernel (see MixKernels).
+        // A more sophisticated soft clipper would use a curve (e.g., tanh).
+        const int64_t energy = mixSources(sources_.data(), sources_.size(), accum_.data(), mix_buffer_.data(),
+                                          samples_per_frame_);
+        mix_level_ = levelFromEnergy(energy, samples_per_frame_);
+        if (SampleOps::instance().meter(mix_buffer_.data(), samples_per_frame_).peak >= 32767) {
+            ++stats_.clippedFrames;
         }
     }
-    
-    if (decoded_pcms.empty()) {
-        return nullptr;
+
+    // 4. Silence: skip the encode unless a comfort-noise frame is due.
+    // The first silent tick is always encoded so listeners' decoders see
+    // the transition out of speech.
+    if (mix_level_ >= silence_level_) {
+        if (silent_ticks_++ % comfort_noise_interval_ticks_ != 0) {
+            ++stats_.skippedEncodes;
+            return false;
+        }
+        if (sources_.empty()) {
+            std::fill(mix_buffer_.begin(), mix_buffer_.end(), 0);
+        }
+        ++stats_.comfortNoiseFrames;
+    } else {
+        silent_ticks_ = 0;
+    }
+
+    return true;
+}
+
+size_t AudioMixer::mixDecoded(const std::vector<PcmSource>& sources, uint32_t tierMask, TierFrames& out) {
+    const bool audible = mixPcm(sources);
+    return encodeTiers(audible, tierMask, out);
+}
+
+size_t AudioMixer::encodeTiers(bool audible, uint32_t tierMask, TierFrames& out) {
+    // The media clock keeps running through skipped ticks, so receivers
+    // can tell a DTX gap from loss.
+    const uint32_t timestamp = timestamp_;
+    timestamp_ += static_cast<uint32_t>(frame_size_);
+    out.fill(nullptr);
+    sole_speaker_ = audible && sources_.size() == 1 ? lone_speaker_ : 0;
+    if (!audible) {
+        return 0;
     }
 
-    // 2. Mix (Additive mixing)
-    for (const auto& pcm_buffer : decoded_pcms) {
-        for (size_t i = 0; i < mix_buffer_.size(); ++i) {
-            // Use 32-bit integers for intermediate summation to prevent overflow
-            int32_t sample = static_cast<int32_t>(mix_buffer_[i]) + pcm_buffer[i];
-            // Clamp to 16-bit range (hard clipping)
-            mix_buffer_[i] = std::clamp(sample, -32768, 32767);
+    // 5a. A lone audible speaker is forwarded as is on tier 0.
+    const bool pass_through = pass_through_enabled_ && (tierMask & 1u) && sources_.size() == 1 &&
+                              lone_packet_ && canPassThrough(*lone_packet_);
+    if (pass_through) {
+        out[0] = MediaFrame::acquire();
+        out[0]->assign(lone_packet_->data(), lone_packet_->size());
+        ++stats_.passThroughs;
+    } else if (pass_through_speaker_ != 0 && (tierMask & 1u)) {
+        encoders_[0]->reset();
+    }
+    pass_through_speaker_ = pass_through ? lone_speaker_ : 0;
+
+    // 5b. Re-encode the mixed buffer once per requested tier. Encoders
+    // and frames are set up here so the encodes themselves touch nothing
+    // shared but the (read-only) mix.
+    int tiers[kMaxTiers];
+    size_t count = 0;
+    for (int tier = pass_through ? 1 : 0; tier < kMaxTiers; ++tier) {
+        if (tierMask & (1u << tier)) {
+            encoderFor(tier);
+            out[tier] = MediaFrame::acquire();
+            tiers[count++] = tier;
+        }
+    }
+    stats_.encodes += count;
+
+    using Clock = std::chrono::steady_clock;
+    int bytes[kMaxTiers] = {};
+    if (serial_cooldown_ > 0) {
+        --serial_cooldown_;
+    }
+    const bool parallel = encode_pool_ && count > 1 && serial_cooldown_ == 0 &&
+                          serial_encode_us_ * static_cast<double>(count) > static_cast<double>(parallel_threshold_us_);
+    const Clock::time_point start = Clock::now();
+    if (parallel) {
+        ++stats_.parallelTicks;
+        updateEncodeCost(encodeForked(tiers, count, out, bytes));
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            bytes[i] = encodeTier(tiers[i], out[tiers[i]].get());
         }
+        updateEncodeCost(std::chrono::duration<double, std::micro>(Clock::now() - start).count() /
+                         static_cast<double>(std::max<size_t>(count, 1)));
     }
-    
-    // 3. Soft clipping (optional, simple division if too loud)
-    // A more sophisticated soft clipper would use a curve (e.g., tanh).
-    if (decoded_pcms.size() > 2) {
-        for (size_t i = 0; i < mix_buffer_.size(); ++i) {
-            mix_buffer_[i] /= (decoded_pcms.size() / 2);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (bytes[i] <= 0) {
+            out[tiers[i]] = nullptr;
+        } else {
+            out[tiers[i]]->setSize(bytes[i]);
         }
     }
 
+    size_t produced = 0;
+    for (MediaFramePtr& frame : out) {
+        if (!frame) {
+            continue;
+        }
+        MediaFrame::Header& header = frame->header();
+        header.sequence = sequence_;
+        header.timestamp = timestamp;
+        header.speakerId = pass_through && frame == out[0] ? pass_through_speaker_ : 0;
+        header.level = mix_level_;
+        ++produced;
+    }
+    if (produced > 0) {
+        ++sequence_;
+    }
+    return produced;
+}
+
+bool AudioMixer::canPassThrough(const MediaFrame& packet) const {
+    // Listeners decode at the room's frame size; a packet of another
+    // duration would shift the room's media clock.
+    return opus_packet_get_nb_samples(packet.data(), static_cast<opus_int32>(packet.size()), sample_rate_) ==
+           frame_size_;
+}
+
+struct AudioMixer::TierJob : ThreadPool::Job {
+    AudioMixer* mixer = nullptr;
+    int tier = 0;
+    MediaFrame* frame = nullptr;
+    int bytes = 0;
+
+    static void encode(ThreadPool::Job& job) {
+        TierJob& self = static_cast<TierJob&>(job);
+        self.bytes = self.mixer->encodeTier(self.tier, self.frame);
+    }
+};
+
+double AudioMixer::encodeForked(const int* tiers, size_t count, TierFrames& out, int* bytes) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
 
-    // 4. Re-encode the mixed buffer
-    encoder_->encode(mix_buffer_, mixed_opus_buffer_);
-    
-    if (mixed_opus_buffer_.empty()) {
-        return nullptr;
+    // Fork all but the first tier, encode that one here, then join.
+    bool forked[kMaxTiers] = {};
+    for (size_t i = 1; i < count; ++i) {
+        if (!tier_jobs_[i]) {
+            tier_jobs_[i] = std::make_unique<TierJob>(); // Once per mixer
+            tier_jobs_[i]->run = &TierJob::encode;
+            tier_jobs_[i]->mixer = this;
+        }
+        TierJob& job = *tier_jobs_[i];
+        job.tier = tiers[i];
+        job.frame = out[tiers[i]].get();
+        forked[i] = encode_pool_->submit(job);
     }
+    bytes[0] = encodeTier(tiers[0], out[tiers[0]].get());
+    const double inline_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
 
-    return std::make_shared<AudioFrame>(mixed_opus_buffer_);
+    // Every encode must finish before the tick returns (the encoders and
+    // the mix are reused next tick). One still queued means the workers
+    // are busy elsewhere: it is done here rather than waited for.
+    size_t reclaimed = 0;
+    for (size_t i = 1; i < count; ++i) {
+        TierJob& job = *tier_jobs_[i];
+        if (!forked[i] || encode_pool_->cancel(job)) {
+            bytes[i] = encodeTier(job.tier, job.frame);
+            ++reclaimed;
+        } else {
+            encode_pool_->wait(job);
+            bytes[i] = job.bytes;
+        }
+    }
+    if (reclaimed > 0) {
+        stats_.reclaimedEncodes += reclaimed;
+        serial_cooldown_ = kSerialCooldownTicks;
+        LOGGER_DEBUG("AudioMixer: {} forked encodes were not started, serial for {} ticks", reclaimed,
+                     kSerialCooldownTicks);
+    }
+    return inline_us;
+}
+
+int AudioMixer::encodeTier(int tier, MediaFrame* frame) {
+    return encoders_[tier]->encode(mix_buffer_.data(), frame->data(), static_cast<int>(MediaFrame::capacity()));
+}
+
+void AudioMixer::updateEncodeCost(double micros) {
+    serial_encode_us_ = serial_encode_us_ == 0.0 ? micros : 0.9 * serial_encode_us_ + 0.1 * micros;
+}
+
+OpusEncoder& AudioMixer::encoderFor(int tier) {
+    if (!encoders_[tier]) {
+        // First listener in this tier: a one-off allocation, the state
+        // itself comes from the OpusStatePool.
+        encoders_[tier] = std::make_unique<OpusEncoder>(sample_rate_, channels_, frame_size_);
+        encoders_[tier]->setBitrate(tier_bitrates_[tier]);
+        LOGGER_DEBUG("AudioMixer: tier {} encoder created at {}bps", tier, tier_bitrates_[tier]);
+    }
+    return *encoders_[tier];
+}
+
+AudioMixer::SpeakerState& AudioMixer::speakerFor(uint32_t speakerId) {
+    const uint64_t tick = stats_.ticks;
+    // A removed state if there is one, else the least recently heard.
+    SpeakerState* oldest = nullptr;
+    for (SpeakerState& speaker : speakers_) {
+        if (speaker.speakerId == speakerId) {
+            speaker.lastTick = tick;
+            return speaker;
+        }
+        if (!oldest || (oldest->speakerId != 0 && (speaker.speakerId == 0 || speaker.lastTick < oldest->lastTick))) {
+            oldest = &speaker;
+        }
+    }
+
+    SpeakerState* state = oldest;
+    const bool reusable = oldest && (oldest->speakerId == 0 || tick - oldest->lastTick > speaker_idle_ticks_);
+    if (!reusable && speakers_.size() < kMaxSpeakerStates) {
+        speakers_.push_back({0, 0, VoiceActivityDetector(frame_ms_)}); // Within the reserve
+        state = &speakers_.back();
+    } else {
+        if (!reusable) {
+            LOGGER_DEBUG("AudioMixer: {} speaker states in use, speaker {} takes over speaker {}'s",
+                         kMaxSpeakerStates, speakerId, oldest->speakerId);
+        }
+        state->vad.reset();
+    }
+    state->speakerId = speakerId;
+    state->lastTick = tick;
+    state->gain = 1.0f;
+    for (const auto& [id, gain] : gains_) {
+        if (id == speakerId) {
+            state->gain = gain;
+            break;
+        }
+    }
+    // Nothing of theirs is in the mix yet, so there is nothing to ramp from.
+    state->appliedGain = state->gain;
+    return *state;
+}
+
+void AudioMixer::setSpeakerGain(uint32_t speakerId, float gain) {
+    gain = std::max(gain, 0.0f);
+    auto it = std::find_if(gains_.begin(), gains_.end(), [speakerId](const auto& entry) {
+        return entry.first == speakerId;
+    });
+    if (it != gains_.end() && gain == 1.0f) {
+        gains_.erase(it);
+    } else if (it != gains_.end()) {
+        it->second = gain;
+    } else if (gain != 1.0f) {
+        gains_.emplace_back(speakerId, gain);
+    }
+
+    // A speaker already mixed ramps to the new gain over their next frame.
+    for (SpeakerState& speaker : speakers_) {
+        if (speaker.speakerId == speakerId) {
+            speaker.gain = gain;
+            break;
+        }
+    }
+}
+
+const int16_t* AudioMixer::applyGain(SpeakerState& speaker, const int16_t* pcm, int16_t* slot) {
+    if (speaker.gain == 1.0f && speaker.appliedGain == 1.0f) {
+        return pcm;
+    }
+    SampleOps::instance().gain(pcm, slot, static_cast<size_t>(frame_size_), channels_, speaker.appliedGain,
+                               speaker.gain);
+    speaker.appliedGain = speaker.gain;
+    return slot;
+}
+
+void AudioMixer::removeSpeaker(uint32_t speakerId) {
+    std::erase_if(gains_, [speakerId](const auto& entry) { return entry.first == speakerId; });
+    for (SpeakerState& speaker : speakers_) {
+        if (speaker.speakerId == speakerId) {
+            speaker.speakerId = 0;
+            speaker.vad.reset();
+            return;
+        }
+    }
+}
+
+bool AudioMixer::isSpeaking(uint32_t speakerId) const {
+    for (const SpeakerState& speaker : speakers_) {
+        if (speaker.speakerId == speakerId) {
+            return speaker.vad.active() && stats_.ticks - speaker.lastTick <= 1;
+        }
+    }
+    return false;
+}
+
+size_t AudioMixer::dominantSpeakers(uint32_t* out, size_t max) const {
+    // Insertion sort into `out` by level; rooms have few speakers.
+    uint8_t levels[kDefaultSourceSlots];
+    max = std::min(max, static_cast<size_t>(kDefaultSourceSlots));
+    size_t count = 0;
+    for (const SpeakerState& speaker : speakers_) {
+        if (!speaker.vad.active() || stats_.ticks - speaker.lastTick > 1) {
+            continue;
+        }
+        const uint8_t level = speaker.vad.level();
+        size_t pos = count;
+        while (pos > 0 && levels[pos - 1] > level) {
+            if (pos < max) {
+                levels[pos] = levels[pos - 1];
+                out[pos] = out[pos - 1];
+            }
+            --pos;
+        }
+        if (pos < max) {
+            levels[pos] = level;
+            out[pos] = speaker.speakerId;
+            count = std::min(count + 1, max);
+        }
+    }
+    return count;
 }
 
 } // namespace lightvoice
@@ -3,9 +3,60 @@
 // src/codec/AudioMixer.h
 //
 // Responsible for mixing audio from multiple sources within a single
-// voice room. It decodes incoming Opus packets, mixes the raw PCM
-// audio, applies a soft clipping algorithm to prevent distortion,
-// and then re-encodes the mixed audio back into a single Opus packet.
+// voice room. It takes each speaker's decoded PCM, mixes it, applies a
+// soft clipping algorithm to prevent distortion, and then re-encodes
+// the mixed audio back into Opus packets.
+//
+// Decoding is the caller's: Opus decoders carry state from packet to
+// packet, so every speaker is decoded with their own (see SpeakerTable
+// and IngressDecoder) and handed over through mixDecoded().
+//
+// The mix path is allocation-free in steady state: sources are summed
+// in a preallocated 32-bit accumulator and encoded straight into
+// pooled MediaFrames.
+//
+// Silent ticks skip the encode entirely. A tick is silent when no
+// source carries audio (none sent, or only DTX packets) or the mix is
+// quieter than the silence threshold. While silent, the mixer emits one
+// DTX/comfort-noise frame every kComfortNoiseIntervalMs so listeners'
+// decoders keep generating comfort noise, and nothing otherwise.
+//
+// Every source also passes through its speaker's
+// VoiceActivityDetector; sources that are not speech are left out of
+// the sum, so a room of open microphones and background noise mixes
+// (and encodes) like a silent one. The per-speaker activity is used to
+// rank dominant speakers.
+//
+// The mix can be encoded at up to kMaxTiers bitrates per tick (a
+// bitrate ladder), one shared encoder per tier, so listeners on slow
+// links get a lighter stream without a per-listener encode. Tier 0 is
+// the room's full bitrate; tier encoders are created on first use.
+//
+// The tier encodes of a tick are independent (one encoder each, reading
+// the same mix), so with an encode pool set they are forked onto it and
+// joined before the tick returns. The mixer thread encodes tier 0
+// itself meanwhile. Each tier has a persistent pool job, so forking
+// allocates nothing. The join never waits behind other work: an encode
+// no worker has started yet is taken back and done on the mixer thread,
+// so a tick waits at most for encodes already running. Forking only
+// pays when the encodes are slow relative to the tick and workers are
+// free, so a mixer stays serial until its measured serial encode time
+// exceeds kParallelEncodePercent of the frame duration, and goes back
+// to serial for kSerialCooldownTicks after it had to take an encode
+// back.
+//
+// Each speaker can be given a gain (e.g. loudness normalization or a
+// moderator turning someone down). Gain changes ramp across one frame
+// so they do not click; unity-gain speakers cost nothing. Gain and the
+// mix's peak meter run on the SampleOps SIMD kernels.
+//
+// Single-speaker pass-through: when exactly one source is audible and
+// its packet has the room's frame size, tier 0 carries a copy of that
+// speaker's own Opus packet, restamped into the room's stream, instead
+// of a re-encode of a mix of one. Lower tiers are still encoded. The
+// speaker's PCM still goes through the VAD; the tier-0 encoder is reset
+// when mixing resumes, so it does not pick up from audio it last saw
+// before the pass-through.
 //
 // Author: Gemini
 // ====================================================================
@@ -13,39 +64,218 @@
 #pragma once
 
 #include "common/noncopyable.h"
+#include "codec/MediaFrame.h"
+#include "codec/MixKernels.h"
+#include "codec/VoiceActivityDetector.h"
+#include <opus/opus_types.h>
+#include <array>
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <utility>
 
 namespace lightvoice {
 
-class OpusDecoder;
 class OpusEncoder;
-
-using AudioFrame = std::vector<unsigned char>;
-using AudioFramePtr = std::shared_ptr<AudioFrame>;
+class ThreadPool;
 
 class AudioMixer : noncopyable {
 public:
+    // Number of PCM slots allocated up front (max simultaneous speakers).
+    static constexpr int kDefaultSourceSlots = 16;
+
+    // Mixes at or below this level (-dBov, RFC 6464) count as silence.
+    static constexpr uint8_t kDefaultSilenceLevel = 60;
+
+    // Time between comfort-noise frames while silent (the same cadence
+    // libopus uses for its own DTX updates).
+    static constexpr int kComfortNoiseIntervalMs = 400;
+
+    // Opus packets this small carry no audio (DTX / TOC byte only).
+    static constexpr size_t kDtxPacketBytes = 2;
+
+    // Bitrate ladder: full, half and quarter of the room's bitrate.
+    static constexpr int kMaxTiers = 3;
+    using TierFrames = std::array<MediaFramePtr, kMaxTiers>;
+
+    // One speaker's frame, decoded by the caller.
+    struct PcmSource {
+        uint32_t speakerId;
+        const int16_t* pcm; // frameSize() * channels() samples
+        const MediaFrame* packet = nullptr; // The Opus packet pcm came from, if any
+    };
+
+    // A speaker's VAD state is recycled after this long without a frame.
+    static constexpr int kSpeakerIdleMs = 5000;
+    // Speaker states kept at most. With none idle, a new speaker takes
+    // over the state of whoever was heard least recently.
+    static constexpr size_t kMaxSpeakerStates = 2 * kDefaultSourceSlots;
+
+    // Fork the tier encodes once serial encoding takes this share of a tick.
+    static constexpr int kParallelEncodePercent = 25;
+    // Ticks to stay serial after a forked encode had to be taken back.
+    static constexpr uint32_t kSerialCooldownTicks = 50;
+
+    struct Stats {
+        uint64_t ticks = 0;              // Calls to mixDecoded()
+        uint64_t gatedSources = 0;       // Decoded frames the VAD kept out of the sum
+        uint64_t encodes = 0;            // Encoder runs, one per tier per tick
+        uint64_t skippedEncodes = 0;     // Silent ticks that did not
+        uint64_t comfortNoiseFrames = 0; // Encodes made only to keep DTX alive
+        uint64_t passThroughs = 0;       // Ticks that forwarded a lone speaker's packet
+        uint64_t clippedFrames = 0;      // Mixes that hit full scale
+        uint64_t parallelTicks = 0;      // Ticks whose tier encodes were forked
+        uint64_t reclaimedEncodes = 0;   // Forked encodes no worker started in time
+
+        double skippedRatio() const {
+            return ticks ? static_cast<double>(skippedEncodes) / static_cast<double>(ticks) : 0.0;
+        }
+    };
+
     AudioMixer(opus_int32 sample_rate, int channels, int frame_size);
     ~AudioMixer();
 
-    // Mixes a collection of Opus frames.
-    // frames: A vector of shared_ptr to Opus audio frames.
-    // Returns a single mixed Opus frame.
-    AudioFramePtr mix(const std::vector<AudioFramePtr>& frames);
+    // Gates and mixes one tick of decoded frames, at most one per
+    // speaker, and encodes the result for every tier whose bit is set in
+    // tierMask, into out[tier] (other entries are reset). All tiers of a
+    // tick share the same sequence number and timestamp, so a listener
+    // can move between tiers without a gap. Call once per tick, with no
+    // sources if nobody sent anything, so silence is tracked in ticks.
+    // Does not allocate once the PCM slots cover sources.size().
+    // Returns the number of tier frames produced (0 on a silent tick
+    // with no comfort-noise frame due).
+    size_t mixDecoded(const std::vector<PcmSource>& sources, uint32_t tierMask, TierFrames& out);
+
+    opus_int32 tierBitrate(int tier) const { return tier_bitrates_[tier]; }
+
+    // Pool the tier encodes may be forked onto; nullptr keeps them on the
+    // calling thread. The pool must outlive the mixer.
+    void setEncodePool(ThreadPool* pool) { encode_pool_ = pool; }
+
+    // Serial encode time per tick (microseconds) above which the tier
+    // encodes are forked. Defaults to kParallelEncodePercent of a frame.
+    void setParallelEncodeThreshold(int64_t micros) { parallel_threshold_us_ = micros; }
+
+    // Enables single-speaker pass-through (on by default).
+    void setPassThrough(bool enabled) { pass_through_enabled_ = enabled; }
+
+    // The speaker whose own packet the last tick forwarded, or 0 if it
+    // was a mix.
+    uint32_t passThroughSpeaker() const { return pass_through_speaker_; }
+
+    // The only audible speaker in the last tick's mix, or 0. Every tier
+    // of that tick, forwarded or re-encoded, is their own voice, so they
+    // need not be sent any of them.
+    uint32_t soleSpeaker() const { return sole_speaker_; }
+
+    // Linear gain applied to the speaker's audio before it is mixed,
+    // from their next frame on. A speaker with a gain other than 1 is
+    // never passed through.
+    void setSpeakerGain(uint32_t speakerId, float gain);
+
+    // Forgets a speaker who left (their VAD and gain), so their state is
+    // free for the next new speaker right away.
+    void removeSpeaker(uint32_t speakerId);
+
+    // Sets the level (-dBov) at or below which a mix counts as silence.
+    void setSilenceLevel(uint8_t level) { silence_level_ = level; }
+
+    const Stats& stats() const { return stats_; }
+
+    // Whether the speaker's VAD currently considers them active.
+    bool isSpeaking(uint32_t speakerId) const;
+
+    // Writes up to `max` active speakers into `out`, loudest first.
+    // Returns the number written. Does not allocate.
+    size_t dominantSpeakers(uint32_t* out, size_t max) const;
+
+    int frameSize() const { return frame_size_; }
+    int frameDurationMs() const { return frame_ms_; }
+    int channels() const { return channels_; }
 
 private:
+    struct SpeakerState {
+        uint32_t speakerId = 0;   // 0 once removed
+        uint64_t lastTick = 0;
+        VoiceActivityDetector vad;
+        float gain = 1.0f;        // Requested gain
+        float appliedGain = 1.0f; // Gain at the end of the last frame
+    };
+
+    // Gate the sources into sources_, then sum them into mix_buffer_.
+    // Return false when the tick is silent and no comfort-noise frame is
+    // due.
+    bool mixPcm(const std::vector<PcmSource>& sources);
+    bool sumSources();
+
+    // Whether a lone speaker's packet can stand in for the tier-0 mix.
+    bool canPassThrough(const MediaFrame& packet) const;
+
+    // Stamps the tick and encodes mix_buffer_ for every tier in the mask.
+    size_t encodeTiers(bool audible, uint32_t tierMask, TierFrames& out);
+    // Encodes mix_buffer_ into frame with the tier's encoder. Safe to run
+    // for different tiers concurrently.
+    int encodeTier(int tier, MediaFrame* frame);
+    // Forks the tiers after the first onto encode_pool_, encodes the
+    // first here and joins. Returns the time the inline encode took.
+    double encodeForked(const int* tiers, size_t count, TierFrames& out, int* bytes);
+    // Folds one tier encode's duration into serial_encode_us_.
+    void updateEncodeCost(double micros);
+
+    OpusEncoder& encoderFor(int tier);
+
+    // Finds the speaker's state. A new speaker takes over a removed or
+    // idle state, or a new one up to kMaxSpeakerStates, or else the state
+    // of whoever was heard least recently; their gain comes from gains_.
+    SpeakerState& speakerFor(uint32_t speakerId);
+
+    // Applies the speaker's gain to pcm, into slot (which may be pcm).
+    // Returns the samples to mix: slot, or pcm itself at unity gain.
+    const int16_t* applyGain(SpeakerState& speaker, const int16_t* pcm, int16_t* slot);
+
+    int16_t* pcmSlot(size_t index) { return pcm_slots_.data() + index * samples_per_frame_; }
+
     opus_int32 sample_rate_;
     int channels_;
     int frame_size_; // e.g., 960 for 20ms at 48kHz
+    int frame_ms_;   // frame_size_ in milliseconds
+    size_t samples_per_frame_; // frame_size_ * channels_
+    uint32_t comfort_noise_interval_ticks_;
+    uint64_t speaker_idle_ticks_;
 
-    std::unique_ptr<OpusDecoder> decoder_;
-    std::unique_ptr<OpusEncoder> encoder_;
+    std::array<std::unique_ptr<OpusEncoder>, kMaxTiers> encoders_;
+    std::array<opus_int32, kMaxTiers> tier_bitrates_;
 
     // Pre-allocated buffers for performance
-    std::vector<int16_t> mix_buffer_;
-    std::vector<unsigned char> mixed_opus_buffer_;
+    std::vector<int16_t> pcm_slots_;  // One gained frame per source
+    std::vector<const int16_t*> sources_; // This tick's sources past the VAD
+    std::vector<int32_t> accum_;      // Wide accumulator for the sum
+    std::vector<int16_t> mix_buffer_; // Clipped mix handed to the encoder
+    uint8_t mix_level_ = 127;         // -dBov of the last mix
+
+    bool pass_through_enabled_ = true;
+    const MediaFrame* lone_packet_ = nullptr; // This tick's only audible packet, if any
+    uint32_t lone_speaker_ = 0;
+    uint32_t pass_through_speaker_ = 0;       // Non-zero while passing through
+    uint32_t sole_speaker_ = 0;               // Non-zero while one speaker is mixed
+
+    uint8_t silence_level_ = kDefaultSilenceLevel;
+    uint32_t silent_ticks_ = 0;       // Consecutive silent ticks so far
+    std::vector<SpeakerState> speakers_; // At most kMaxSpeakerStates
+    // Gains other than 1, by speaker. Kept apart from speakers_ so a gain
+    // outlives its speaker's state; dropped by removeSpeaker().
+    std::vector<std::pair<uint32_t, float>> gains_;
+    Stats stats_;
+
+    struct TierJob; // A tier's encode as a ThreadPool::Job
+    ThreadPool* encode_pool_ = nullptr;
+    std::array<std::unique_ptr<TierJob>, kMaxTiers> tier_jobs_; // Created on first fork
+    int64_t parallel_threshold_us_;
+    double serial_encode_us_ = 0.0;   // Smoothed serial cost of one tier encode
+    uint32_t serial_cooldown_ = 0;    // Ticks left before forking again
+
+    uint32_t sequence_ = 0;
+    uint32_t timestamp_ = 0;
 };
 
 } // namespace lightvoice
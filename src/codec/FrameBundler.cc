@@ -0,0 +1,100 @@
+// ====================================================================
+// LightVoice: Frame Bundler
+// src/codec/FrameBundler.cc
+//
+// Implementation of the FrameBundler class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/FrameBundler.h"
+#include "common/Logger.h"
+#include <algorithm>
+#include <new>
+
+namespace lightvoice {
+
+FrameBundler::FrameBundler(int framesPerPacket, opus_int32 sampleRate)
+    : repacketizer_(opus_repacketizer_create()),
+      frames_per_packet_(std::clamp(framesPerPacket, kMinFrames, kMaxFrames)),
+      sample_rate_(sampleRate) {
+    if (!repacketizer_) {
+        throw std::bad_alloc();
+    }
+}
+
+FrameBundler::~FrameBundler() {
+    opus_repacketizer_destroy(repacketizer_);
+}
+
+MediaFramePtr FrameBundler::push(const MediaFramePtr& frame) {
+    MediaFramePtr out;
+
+    // Merging across a gap (e.g. skipped silent ticks) would collapse time.
+    if (count_ > 0 && frame->header().timestamp != next_timestamp_) {
+        out = flush();
+    }
+
+    if (!append(frame)) {
+        if (count_ == 0) {
+            LOGGER_WARN("FrameBundler: dropping a frame the repacketizer rejects ({} bytes)", frame->size());
+            return out;
+        }
+        // New Opus configuration (e.g. a tier or bandwidth change): ship
+        // the current bundle and start the next one with this frame.
+        out = flush();
+        append(frame);
+    }
+
+    if (!out && count_ >= static_cast<size_t>(frames_per_packet_)) {
+        out = flush();
+    }
+    return out;
+}
+
+MediaFramePtr FrameBundler::flush() {
+    if (count_ == 0) {
+        return nullptr;
+    }
+
+    MediaFramePtr out;
+    if (count_ == 1) {
+        // Nothing to merge, the frame goes out as it is.
+        out = std::move(pending_[0]);
+    } else {
+        out = MediaFrame::acquire();
+        int bytes = opus_repacketizer_out(repacketizer_, out->data(), static_cast<opus_int32>(MediaFrame::capacity()));
+        if (bytes < 0) {
+            LOGGER_ERROR("FrameBundler: repacketizer failed: {}", opus_strerror(bytes));
+            out = nullptr;
+        } else {
+            out->setSize(static_cast<size_t>(bytes));
+            // The bundle starts where its first frame did and is as loud
+            // as its loudest frame.
+            out->header() = pending_[0]->header();
+            for (size_t i = 1; i < count_; ++i) {
+                out->header().level = std::min(out->header().level, pending_[i]->header().level);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count_; ++i) {
+        pending_[i] = nullptr;
+    }
+    count_ = 0;
+    opus_repacketizer_init(repacketizer_);
+    return out;
+}
+
+bool FrameBundler::append(const MediaFramePtr& frame) {
+    // The repacketizer keeps pointers into the frame, which pending_ keeps alive.
+    if (opus_repacketizer_cat(repacketizer_, frame->data(), static_cast<opus_int32>(frame->size())) != OPUS_OK) {
+        return false;
+    }
+    int samples = opus_packet_get_nb_samples(frame->data(), static_cast<opus_int32>(frame->size()), sample_rate_);
+    next_timestamp_ = frame->header().timestamp + static_cast<uint32_t>(std::max(samples, 0));
+    pending_[count_++] = frame;
+    return true;
+}
+
+} // namespace lightvoice
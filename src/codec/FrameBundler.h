@@ -0,0 +1,64 @@
+// ====================================================================
+// LightVoice: Frame Bundler
+// src/codec/FrameBundler.h
+//
+// Merges 2-3 consecutive mixed Opus frames into one multi-frame Opus
+// packet with libopus's repacketizer, for listeners that trade latency
+// for fewer packets (recorders, PSTN bridges). No audio is decoded:
+// the repacketizer only rewrites the packet framing. Pending frames
+// are held by reference until the bundle is written out.
+//
+// Frames are only merged when they are contiguous in time and share
+// an Opus configuration (mode, bandwidth, frame size); anything else
+// closes the current bundle first.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include "codec/MediaFrame.h"
+#include <opus/opus.h>
+#include <array>
+#include <cstddef>
+
+namespace lightvoice {
+
+class FrameBundler : noncopyable {
+public:
+    static constexpr int kMinFrames = 2;
+    static constexpr int kMaxFrames = 3;
+
+    // framesPerPacket is clamped to [kMinFrames, kMaxFrames]; sampleRate
+    // is the room's, used to advance the expected timestamp.
+    FrameBundler(int framesPerPacket, opus_int32 sampleRate);
+    ~FrameBundler();
+
+    // Queues one mixed frame. Returns a bundled packet once
+    // framesPerPacket frames are queued, or the previous bundle if this
+    // frame cannot join it; nullptr while still collecting.
+    MediaFramePtr push(const MediaFramePtr& frame);
+
+    // Emits whatever is queued, e.g. when the mix goes silent, so no
+    // audio is held back. Returns nullptr if nothing is queued.
+    MediaFramePtr flush();
+
+    int framesPerPacket() const { return frames_per_packet_; }
+    size_t pending() const { return count_; }
+
+private:
+    // Adds a frame to the repacketizer. Fails if it does not match the
+    // queued frames' configuration or the bundle would exceed 120ms.
+    bool append(const MediaFramePtr& frame);
+
+    OpusRepacketizer* repacketizer_;
+    int frames_per_packet_;
+    opus_int32 sample_rate_;
+
+    std::array<MediaFramePtr, kMaxFrames> pending_;
+    size_t count_ = 0;
+    uint32_t next_timestamp_ = 0; // Timestamp the next contiguous frame carries
+};
+
+} // namespace lightvoice
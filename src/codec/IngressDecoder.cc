@@ -0,0 +1,70 @@
+// ====================================================================
+// LightVoice: Ingress Decoder
+// src/codec/IngressDecoder.cc
+//
+// Implementation of the IngressDecoder class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/IngressDecoder.h"
+#include "codec/AudioMixer.h"
+#include "codec/OpusDecoder.h"
+#include "common/Logger.h"
+
+namespace lightvoice {
+
+IngressDecoder::IngressDecoder(uint32_t speakerId, opus_int32 sample_rate, int channels, int frame_size)
+    : speaker_id_(speakerId),
+      frame_size_(frame_size),
+      decoder_(std::make_unique<OpusDecoder>(sample_rate, channels)),
+      ring_(kRingFrames, PcmFrame{std::vector<int16_t>(static_cast<size_t>(frame_size) * channels), {}, nullptr}) {}
+
+IngressDecoder::~IngressDecoder() = default;
+
+bool IngressDecoder::decode(const MediaFramePtr& frame) {
+    if (frame->size() <= AudioMixer::kDtxPacketBytes) {
+        return false;
+    }
+    PcmFrame* slot = ring_.beginWrite();
+    if (!slot) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        LOGGER_DEBUG("IngressDecoder: speaker {} ring full, dropping frame", speaker_id_);
+        return false;
+    }
+    int decoded = decoder_->decode(frame->data(), frame->size(), slot->pcm.data(), frame_size_);
+    if (decoded != frame_size_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slot->header = frame->header();
+    slot->packet = frame;
+    ring_.commitWrite();
+    return true;
+}
+
+const IngressDecoder::PcmFrame* IngressDecoder::front() {
+    while (ring_.size() > kMaxBufferedFrames) {
+        pop();
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return ring_.front();
+}
+
+void IngressDecoder::pop() {
+    // The packet goes back to the pool now, not when the slot is reused.
+    if (PcmFrame* frame = ring_.front()) {
+        frame->packet = nullptr;
+        ring_.pop();
+    }
+}
+
+void IngressDecoder::reset(uint32_t speakerId) {
+    while (ring_.front()) {
+        pop();
+    }
+    decoder_->reset();
+    speaker_id_ = speakerId;
+}
+
+} // namespace lightvoice
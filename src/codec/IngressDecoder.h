@@ -0,0 +1,84 @@
+// ====================================================================
+// LightVoice: Ingress Decoder
+// src/codec/IngressDecoder.h
+//
+// Decode-on-ingress for one speaker. The IO thread that receives the
+// speaker's packet decodes it right away, with the speaker's own Opus
+// decoder, into the next slot of a small PCM ring; the mixer thread
+// later takes one decoded frame per tick and only sums and encodes.
+// Decode work thereby spreads across the IO threads instead of
+// serialising on the mixer.
+//
+// The ring is single-producer (the speaker's connection lives on one
+// IO loop) and single-consumer (the mixer thread), so neither side
+// takes a lock.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include "codec/MediaFrame.h"
+#include "pool/SpscRing.h"
+#include <opus/opus_types.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lightvoice {
+
+class OpusDecoder;
+
+class IngressDecoder : noncopyable {
+public:
+    // Frames a speaker can have queued for the mixer (160ms at 20ms),
+    // here and in the packet rings of rooms that decode on the mixer.
+    static constexpr size_t kRingFrames = 8;
+    // The mixer drops older frames beyond this many, bounding latency.
+    static constexpr size_t kMaxBufferedFrames = 3;
+
+    struct PcmFrame {
+        std::vector<int16_t> pcm;     // frame_size * channels samples
+        MediaFrame::Header header;
+        MediaFramePtr packet;         // The Opus packet pcm was decoded from
+    };
+
+    // Throws std::runtime_error if the decoder cannot be created.
+    IngressDecoder(uint32_t speakerId, opus_int32 sample_rate, int channels, int frame_size);
+    ~IngressDecoder();
+
+    // --- IO thread ---
+
+    // Decodes one packet into the ring, which keeps a reference to it
+    // until the frame is popped (for single-speaker pass-through).
+    // Returns false if the frame was dropped: DTX (no audio),
+    // undecodable, or the ring is full.
+    bool decode(const MediaFramePtr& frame);
+
+    // --- Mixer thread ---
+
+    // The oldest decoded frame, or nullptr if none is ready. Frames
+    // beyond kMaxBufferedFrames are discarded first.
+    const PcmFrame* front();
+    // Releases the frame returned by front().
+    void pop();
+    // Discards every queued frame and the decoder's history, and hands
+    // the decoder to another speaker. No decode() may be running.
+    void reset(uint32_t speakerId);
+
+    uint32_t speakerId() const { return speaker_id_; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    uint32_t speaker_id_;
+    const int frame_size_;
+    std::unique_ptr<OpusDecoder> decoder_;
+    SpscRing<PcmFrame> ring_;
+    std::atomic<uint64_t> dropped_{0};
+};
+
+using IngressDecoderPtr = std::shared_ptr<IngressDecoder>;
+
+} // namespace lightvoice
@@ -0,0 +1,61 @@
+// ====================================================================
+// LightVoice: Media Frame
+// src/codec/MediaFrame.cc
+//
+// Implementation of MediaFrame and its process-wide slab pool.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/MediaFrame.h"
+#include "pool/SlabPool.h"
+#include <cstring>
+
+namespace lightvoice {
+
+namespace {
+
+// 256 frames (~400KB) per slab; two slabs cover a busy server's
+// in-flight packets without growing.
+using MediaFramePool = SlabPool<MediaFrame, 256>;
+
+MediaFramePool& framePool() {
+    // Intentionally leaked: frames held by other statics may still be
+    // released during shutdown.
+    static MediaFramePool* pool = new MediaFramePool(2);
+    return *pool;
+}
+
+} // namespace
+
+MediaFramePtr MediaFrame::acquire() {
+    MediaFrame* frame = framePool().acquire();
+    frame->refs_.store(1, std::memory_order_relaxed);
+    frame->size_ = 0;
+    frame->header_ = Header{};
+    return MediaFramePtr(frame);
+}
+
+size_t MediaFrame::poolCapacity() {
+    return framePool().capacity();
+}
+
+bool MediaFrame::assign(const void* data, size_t len) {
+    if (len > kMaxPayload) {
+        size_ = 0;
+        return false;
+    }
+    std::memcpy(payload_, data, len);
+    size_ = static_cast<uint16_t>(len);
+    return true;
+}
+
+void MediaFrame::release() {
+    // acq_rel: the last owner must observe every write made through the
+    // other references before the frame is recycled.
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        framePool().release(this);
+    }
+}
+
+} // namespace lightvoice
@@ -0,0 +1,117 @@
+// ====================================================================
+// LightVoice: Media Frame
+// src/codec/MediaFrame.h
+//
+// A pooled, fixed-capacity container for one Opus packet plus its
+// media header (sequence, timestamp, speaker id and level). Frames
+// live in process-wide slabs and carry an intrusive reference count,
+// so passing a packet from the IO threads to the mixer and on to every
+// listener costs no heap allocation, no shared_ptr control block and
+// a single refcount word next to the payload.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace lightvoice {
+
+class MediaFramePtr;
+
+class MediaFrame : noncopyable {
+public:
+    // Fits any Opus packet (max 1275 bytes per frame) in one MTU.
+    static constexpr size_t kMaxPayload = 1500;
+
+    struct Header {
+        uint32_t sequence = 0;
+        uint32_t timestamp = 0;  // In samples at the room's sample rate
+        uint32_t speakerId = 0;  // 0 for a server mix
+        uint8_t level = 127;     // Audio level in -dBov (0 = loudest, 127 = silence)
+    };
+
+    // Takes a frame from the pool with an empty payload and a reset header.
+    static MediaFramePtr acquire();
+
+    // Total frames allocated by the pool, in use or free.
+    static size_t poolCapacity();
+
+    Header& header() { return header_; }
+    const Header& header() const { return header_; }
+
+    unsigned char* data() { return payload_; }
+    const unsigned char* data() const { return payload_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    static constexpr size_t capacity() { return kMaxPayload; }
+
+    // Sets the payload length after writing into data() directly.
+    void setSize(size_t size) { size_ = static_cast<uint16_t>(size < kMaxPayload ? size : kMaxPayload); }
+
+    // Copies a payload in. Returns false (and leaves the frame empty) if
+    // it does not fit.
+    bool assign(const void* data, size_t len);
+
+private:
+    friend class MediaFramePtr;
+
+    void addRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    void release();
+
+    std::atomic<uint32_t> refs_{0};
+    uint16_t size_ = 0;
+    Header header_;
+    unsigned char payload_[kMaxPayload];
+};
+
+// Intrusive smart pointer to a pooled MediaFrame. The frame goes back to
+// the pool when the last MediaFramePtr to it is destroyed.
+class MediaFramePtr {
+public:
+    MediaFramePtr() = default;
+    MediaFramePtr(std::nullptr_t) {}
+
+    MediaFramePtr(const MediaFramePtr& other) : frame_(other.frame_) {
+        if (frame_) {
+            frame_->addRef();
+        }
+    }
+
+    MediaFramePtr(MediaFramePtr&& other) noexcept : frame_(std::exchange(other.frame_, nullptr)) {}
+
+    MediaFramePtr& operator=(MediaFramePtr other) noexcept {
+        std::swap(frame_, other.frame_);
+        return *this;
+    }
+
+    ~MediaFramePtr() { reset(); }
+
+    void reset() {
+        if (frame_) {
+            std::exchange(frame_, nullptr)->release();
+        }
+    }
+
+    MediaFrame* get() const { return frame_; }
+    MediaFrame& operator*() const { return *frame_; }
+    MediaFrame* operator->() const { return frame_; }
+    explicit operator bool() const { return frame_ != nullptr; }
+
+    friend bool operator==(const MediaFramePtr& a, const MediaFramePtr& b) { return a.frame_ == b.frame_; }
+
+private:
+    friend class MediaFrame;
+
+    // Adopts a frame whose reference count has already been set to 1.
+    explicit MediaFramePtr(MediaFrame* frame) : frame_(frame) {}
+
+    MediaFrame* frame_ = nullptr;
+};
+
+} // namespace lightvoice
@@ -8,32 +8,25 @@
 // ====================================================================
 
 #include "codec/OpusDecoder.h"
+#include "codec/OpusStatePool.h"
 #include "common/Logger.h"
 
 namespace lightvoice {
 
 OpusDecoder::OpusDecoder(opus_int32 sample_rate, int channels)
-    : channels_(channels) {
-    int error;
-    decoder_ = opus_decoder_create(sample_rate, channels, &error);
-    if (error != OPUS_OK) {
-        LOGGER_CRITICAL("Failed to create Opus decoder: {}", opus_strerror(error));
-    }
+    : decoder_(OpusStatePool::instance().acquireDecoder(sample_rate, channels)),
+      channels_(channels) {
 }
 
 OpusDecoder::~OpusDecoder() {
-    if (decoder_) {
-        opus_decoder_destroy(decoder_);
-    }
+    OpusStatePool::instance().releaseDecoder(decoder_);
 }
 
 int OpusDecoder::decode(const std::vector<unsigned char>& opus_data, std::vector<int16_t>& pcm, int frame_size) {
     pcm.resize(frame_size * channels_);
 
-    int decoded_samples = opus_decode(decoder_, opus_data.empty() ? nullptr : opus_data.data(), opus_data.size(), pcm.data(), frame_size, 0);
-
+    int decoded_samples = decode(opus_data.data(), opus_data.size(), pcm.data(), frame_size);
     if (decoded_samples < 0) {
-        LOGGER_ERROR("Opus decoding failed: {}", opus_strerror(decoded_samples));
         return decoded_samples;
     }
     
@@ -41,4 +34,18 @@ int OpusDecoder::decode(const std::vector<unsigned char>& opus_data, std::vector
     return decoded_samples;
 }
 
+int OpusDecoder::decode(const unsigned char* opus_data, size_t len, int16_t* pcm, int frame_size) {
+    // A null/empty packet asks Opus for packet loss concealment.
+    int decoded_samples = opus_decode(decoder_, len == 0 ? nullptr : opus_data, static_cast<opus_int32>(len), pcm, frame_size, 0);
+
+    if (decoded_samples < 0) {
+        LOGGER_ERROR("Opus decoding failed: {}", opus_strerror(decoded_samples));
+    }
+    return decoded_samples;
+}
+
+void OpusDecoder::reset() {
+    opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+}
+
 } // namespace lightvoice
@@ -6,6 +6,10 @@
 // responsible for taking Opus packets and decoding them back into
 // raw PCM audio data.
 //
+// The libopus state is borrowed from the process-wide OpusStatePool
+// and returned to it on destruction. The constructor throws
+// std::runtime_error if libopus rejects the configuration.
+//
 // Author: Gemini
 // ====================================================================
 
@@ -14,6 +18,7 @@
 #include "common/noncopyable.h"
 #include <opus/opus.h>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 namespace lightvoice {
@@ -30,8 +35,16 @@ public:
     // Returns the number of samples decoded per channel, or a negative error code.
     int decode(const std::vector<unsigned char>& opus_data, std::vector<int16_t>& pcm, int frame_size);
 
+    // Decodes straight into a caller-owned buffer of at least
+    // frame_size * channels samples. Never allocates.
+    int decode(const unsigned char* opus_data, size_t len, int16_t* pcm, int frame_size);
+
+    // Drops the decoder's history (OPUS_RESET_STATE), e.g. before it
+    // starts on another speaker's stream.
+    void reset();
+
 private:
-    OpusDecoder* decoder_ = nullptr;
+    ::OpusDecoder* decoder_ = nullptr;
     int channels_;
 };
 
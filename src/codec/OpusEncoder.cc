@@ -8,44 +8,87 @@
 // ====================================================================
 
 #include "codec/OpusEncoder.h"
+#include "codec/OpusStatePool.h"
 #include "common/Logger.h"
 
 namespace lightvoice {
 
-OpusEncoder::OpusEncoder(opus_int32 sample_rate, int channels, int frame_size)
-    : channels_(channels), frame_size_(frame_size) {
-    int error;
-    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
-    if (error != OPUS_OK) {
-        LOGGER_CRITICAL("Failed to create Opus encoder: {}", opus_strerror(error));
+namespace {
+
+int maxBandwidth(opus_int32 sample_rate) {
+    switch (sample_rate) {
+    case 8000:  return OPUS_BANDWIDTH_NARROWBAND;
+    case 12000: return OPUS_BANDWIDTH_MEDIUMBAND;
+    case 16000: return OPUS_BANDWIDTH_WIDEBAND;
+    case 24000: return OPUS_BANDWIDTH_SUPERWIDEBAND;
+    default:    return OPUS_BANDWIDTH_FULLBAND;
     }
-    // Set a reasonable bitrate
-    opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(64000));
+}
+
+} // namespace
+
+opus_int32 OpusEncoder::defaultBitrate(opus_int32 sample_rate) {
+    switch (sample_rate) {
+    case 8000:  return 16000;
+    case 12000: return 20000;
+    case 16000: return 24000;
+    case 24000: return 32000;
+    default:    return 64000;
+    }
+}
+
+OpusEncoder::OpusEncoder(opus_int32 sample_rate, int channels, int frame_size)
+    : encoder_(OpusStatePool::instance().acquireEncoder(sample_rate, channels, OPUS_APPLICATION_VOIP)),
+      channels_(channels),
+      frame_size_(frame_size) {
+    // Pooled states keep the previous owner's ctl settings, so every
+    // setting this wrapper relies on is applied explicitly.
+    // Set a reasonable bitrate for the room's audio bandwidth; a
+    // narrowband room gains nothing from a fullband bitrate.
+    opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(defaultBitrate(sample_rate)));
+    opus_encoder_ctl(encoder_, OPUS_SET_MAX_BANDWIDTH(maxBandwidth(sample_rate)));
+    // Let silent frames shrink to DTX packets.
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(1));
+    // Rooms carry speech. Left to its classifier, the encoder can take a
+    // mix for music and switch it to CELT at some rates and not others,
+    // so the coding mode (the bulk of the cost) would follow the content
+    // rather than the room's sample rate.
+    opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
 }
 
 OpusEncoder::~OpusEncoder() {
-    if (encoder_) {
-        opus_encoder_destroy(encoder_);
+    OpusStatePool::instance().releaseEncoder(encoder_);
+}
+
+void OpusEncoder::setBitrate(opus_int32 bitrate) {
+    int error = opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate));
+    if (error != OPUS_OK) {
+        LOGGER_ERROR("OpusEncoder: cannot set bitrate {}: {}", bitrate, opus_strerror(error));
     }
 }
 
+void OpusEncoder::reset() {
+    opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+}
+
 int OpusEncoder::encode(const std::vector<int16_t>& pcm, std::vector<unsigned char>& output) {
     if (pcm.size() != static_cast<size_t>(frame_size_ * channels_)) {
         LOGGER_ERROR("OpusEncoder: incorrect PCM size. Expected {}, got {}", frame_size_ * channels_, pcm.size());
         return 0;
     }
-    
-    // Opus recommends a max packet size for safety
-    output.resize(4000);
 
-    int encoded_bytes = opus_encode(encoder_, pcm.data(), frame_size_, output.data(), output.size());
+    int encoded_bytes = encode(pcm.data(), scratch_.data(), kMaxPacketSize);
+    output.assign(scratch_.begin(), scratch_.begin() + encoded_bytes);
+    return encoded_bytes;
+}
+
+int OpusEncoder::encode(const int16_t* pcm, unsigned char* output, int max_bytes) {
+    int encoded_bytes = opus_encode(encoder_, pcm, frame_size_, output, max_bytes);
 
     if (encoded_bytes < 0) {
         LOGGER_ERROR("Opus encoding failed: {}", opus_strerror(encoded_bytes));
         return 0;
     }
-    
-    output.resize(encoded_bytes);
     return encoded_bytes;
 }
 
@@ -4,7 +4,12 @@
 //
 // A C++ wrapper around the libopus encoder. This class is
 // responsible for taking raw PCM audio data and encoding it into
-// Opus packets.
+// Opus packets. DTX is enabled, so silence encodes to packets of a
+// byte or two, and the input is declared as speech.
+//
+// The libopus state is borrowed from the process-wide OpusStatePool
+// and returned to it on destruction. The constructor throws
+// std::runtime_error if libopus rejects the configuration.
 //
 // Author: Gemini
 // ====================================================================
@@ -13,6 +18,7 @@
 
 #include "common/noncopyable.h"
 #include <opus/opus.h>
+#include <array>
 #include <vector>
 #include <cstdint>
 
@@ -20,22 +26,45 @@ namespace lightvoice {
 
 class OpusEncoder : noncopyable {
 public:
+    // Upper bound for a single encoded packet, as recommended by libopus.
+    static constexpr int kMaxPacketSize = 4000;
+
     // sample_rate: e.g., 48000
     // channels: 1 (mono) or 2 (stereo)
     // frame_size: e.g., 960 for 20ms at 48kHz
     OpusEncoder(opus_int32 sample_rate, int channels, int frame_size);
     ~OpusEncoder();
 
+    // Bitrate used for a room at the given sample rate (64kbps fullband,
+    // scaled down for narrower bands).
+    static opus_int32 defaultBitrate(opus_int32 sample_rate);
+
+    // Changes the target bitrate; takes effect from the next frame.
+    void setBitrate(opus_int32 bitrate);
+
+    // Drops the encoder's history (OPUS_RESET_STATE), e.g. before
+    // resuming after a gap in the audio it was fed.
+    void reset();
+
     // Encodes a single frame of PCM data.
     // pcm: Input buffer of int16_t samples.
     // output: Buffer to store the encoded Opus data.
     // Returns the number of bytes written to the output buffer.
     int encode(const std::vector<int16_t>& pcm, std::vector<unsigned char>& output);
 
+    // Encodes one frame (frame_size * channels samples) into a caller-owned
+    // buffer of max_bytes. Never allocates.
+    // Returns the number of bytes written, or 0 on failure.
+    int encode(const int16_t* pcm, unsigned char* output, int max_bytes);
+
 private:
-    OpusEncoder* encoder_ = nullptr;
+    ::OpusEncoder* encoder_ = nullptr;
     int channels_;
     int frame_size_;
+
+    // Scratch packet for the vector overload, so it never has to grow
+    // the caller's buffer to kMaxPacketSize just to shrink it again.
+    std::array<unsigned char, kMaxPacketSize> scratch_;
 };
 
 } // namespace lightvoice
@@ -0,0 +1,233 @@
+// ====================================================================
+// LightVoice: Opus State Pool
+// src/codec/OpusStatePool.cc
+//
+// Implementation of the OpusStatePool class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/OpusStatePool.h"
+#include "common/Logger.h"
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+namespace lightvoice {
+
+namespace {
+
+// Slots are cache-line aligned so neighbouring states never share a line.
+constexpr size_t kSlotAlign = 64;
+
+size_t alignUp(size_t n) {
+    return (n + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+}
+
+} // namespace
+
+void OpusStatePool::Region::Free::operator()(unsigned char* p) const {
+    std::free(p);
+}
+
+bool OpusStatePool::Region::contains(const void* p) const {
+    auto* c = static_cast<const unsigned char*>(p);
+    return c >= memory.get() && c < memory.get() + stride * count;
+}
+
+size_t OpusStatePool::Region::indexOf(const void* p) const {
+    return static_cast<size_t>(static_cast<const unsigned char*>(p) - memory.get()) / stride;
+}
+
+OpusStatePool& OpusStatePool::instance() {
+    static OpusStatePool instance;
+    return instance;
+}
+
+OpusStatePool::Region OpusStatePool::makeRegion(size_t slotSize, size_t count) {
+    Region region;
+    region.stride = alignUp(slotSize);
+    region.count = count;
+    region.configs.resize(count);
+    if (count == 0) {
+        return region;
+    }
+    auto* memory = static_cast<unsigned char*>(std::aligned_alloc(kSlotAlign, region.stride * count));
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    region.memory.reset(memory);
+    return region;
+}
+
+void OpusStatePool::prewarm(size_t encoders, size_t decoders,
+                            opus_int32 sample_rate, int channels, int application) {
+    Region encRegion = makeRegion(static_cast<size_t>(opus_encoder_get_size(kMaxChannels)), encoders);
+    Region decRegion = makeRegion(static_cast<size_t>(opus_decoder_get_size(kMaxChannels)), decoders);
+
+    // Pay the codec init cost now rather than on the first room creation.
+    for (size_t i = 0; i < encoders; ++i) {
+        auto* enc = reinterpret_cast<::OpusEncoder*>(encRegion.slot(i));
+        int error = opus_encoder_init(enc, sample_rate, channels, application);
+        if (error != OPUS_OK) {
+            LOGGER_ERROR("OpusStatePool: failed to init encoder slot: {}", opus_strerror(error));
+            continue;
+        }
+        encRegion.configs[i] = {sample_rate, channels, application};
+    }
+    for (size_t i = 0; i < decoders; ++i) {
+        auto* dec = reinterpret_cast<::OpusDecoder*>(decRegion.slot(i));
+        int error = opus_decoder_init(dec, sample_rate, channels);
+        if (error != OPUS_OK) {
+            LOGGER_ERROR("OpusStatePool: failed to init decoder slot: {}", opus_strerror(error));
+            continue;
+        }
+        decRegion.configs[i] = {sample_rate, channels, 0};
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeEncoders_.reserve(freeEncoders_.size() + encoders);
+    for (size_t i = 0; i < encoders; ++i) {
+        freeEncoders_.push_back(reinterpret_cast<::OpusEncoder*>(encRegion.slot(i)));
+    }
+    freeDecoders_.reserve(freeDecoders_.size() + decoders);
+    for (size_t i = 0; i < decoders; ++i) {
+        freeDecoders_.push_back(reinterpret_cast<::OpusDecoder*>(decRegion.slot(i)));
+    }
+    encoderRegions_.push_back(std::move(encRegion));
+    decoderRegions_.push_back(std::move(decRegion));
+
+    LOGGER_INFO("OpusStatePool pre-warmed {} encoders ({}B each) and {} decoders ({}B each)",
+                encoders, encoderRegions_.back().stride, decoders, decoderRegions_.back().stride);
+}
+
+OpusStatePool::SlotConfig* OpusStatePool::configOf(std::vector<Region>& regions, const void* state) {
+    for (Region& region : regions) {
+        if (region.contains(state)) {
+            return &region.configs[region.indexOf(state)];
+        }
+    }
+    return nullptr;
+}
+
+::OpusEncoder* OpusStatePool::acquireEncoder(opus_int32 sample_rate, int channels, int application) {
+    ::OpusEncoder* encoder = nullptr;
+    SlotConfig* config = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!freeEncoders_.empty()) {
+            encoder = freeEncoders_.back();
+            freeEncoders_.pop_back();
+            config = configOf(encoderRegions_, encoder);
+        } else {
+            ++heapFallbacks_;
+        }
+    }
+
+    int error = OPUS_OK;
+    if (!encoder) {
+        LOGGER_WARN("OpusStatePool: encoder pool exhausted, allocating from the heap");
+        encoder = opus_encoder_create(sample_rate, channels, application, &error);
+    } else if (config->sampleRate != sample_rate || config->channels != channels ||
+               config->application != application) {
+        error = opus_encoder_init(encoder, sample_rate, channels, application);
+        if (error == OPUS_OK) {
+            *config = {sample_rate, channels, application};
+        } else {
+            // The slot is only half initialised: skip the reset and force
+            // a full re-init on its next acquire.
+            *config = {};
+            std::lock_guard<std::mutex> lock(mutex_);
+            freeEncoders_.push_back(encoder);
+        }
+    }
+
+    if (error != OPUS_OK) {
+        throw std::runtime_error(fmt::format("Failed to create Opus encoder ({} Hz, {} ch): {}",
+                                             sample_rate, channels, opus_strerror(error)));
+    }
+    return encoder;
+}
+
+::OpusDecoder* OpusStatePool::acquireDecoder(opus_int32 sample_rate, int channels) {
+    ::OpusDecoder* decoder = nullptr;
+    SlotConfig* config = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!freeDecoders_.empty()) {
+            decoder = freeDecoders_.back();
+            freeDecoders_.pop_back();
+            config = configOf(decoderRegions_, decoder);
+        } else {
+            ++heapFallbacks_;
+        }
+    }
+
+    int error = OPUS_OK;
+    if (!decoder) {
+        LOGGER_WARN("OpusStatePool: decoder pool exhausted, allocating from the heap");
+        decoder = opus_decoder_create(sample_rate, channels, &error);
+    } else if (config->sampleRate != sample_rate || config->channels != channels) {
+        error = opus_decoder_init(decoder, sample_rate, channels);
+        if (error == OPUS_OK) {
+            *config = {sample_rate, channels, 0};
+        } else {
+            *config = {};
+            std::lock_guard<std::mutex> lock(mutex_);
+            freeDecoders_.push_back(decoder);
+        }
+    }
+
+    if (error != OPUS_OK) {
+        throw std::runtime_error(fmt::format("Failed to create Opus decoder ({} Hz, {} ch): {}",
+                                             sample_rate, channels, opus_strerror(error)));
+    }
+    return decoder;
+}
+
+void OpusStatePool::releaseEncoder(::OpusEncoder* encoder) {
+    if (!encoder) {
+        return;
+    }
+    opus_encoder_ctl(encoder, OPUS_RESET_STATE);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (configOf(encoderRegions_, encoder)) {
+            freeEncoders_.push_back(encoder);
+            return;
+        }
+    }
+    opus_encoder_destroy(encoder);
+}
+
+void OpusStatePool::releaseDecoder(::OpusDecoder* decoder) {
+    if (!decoder) {
+        return;
+    }
+    opus_decoder_ctl(decoder, OPUS_RESET_STATE);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (configOf(decoderRegions_, decoder)) {
+            freeDecoders_.push_back(decoder);
+            return;
+        }
+    }
+    opus_decoder_destroy(decoder);
+}
+
+OpusStatePool::Stats OpusStatePool::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    for (const Region& region : encoderRegions_) {
+        s.encoders += region.count;
+    }
+    for (const Region& region : decoderRegions_) {
+        s.decoders += region.count;
+    }
+    s.freeEncoders = freeEncoders_.size();
+    s.freeDecoders = freeDecoders_.size();
+    s.heapFallbacks = heapFallbacks_;
+    return s;
+}
+
+} // namespace lightvoice
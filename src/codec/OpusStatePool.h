@@ -0,0 +1,102 @@
+// ====================================================================
+// LightVoice: Opus State Pool
+// src/codec/OpusStatePool.h
+//
+// A process-wide pool of preallocated libopus encoder and decoder
+// states. All states live in one contiguous region sized with
+// opus_encoder_get_size / opus_decoder_get_size (for the largest
+// channel count), are initialised once when the pool is pre-warmed,
+// and are reset with OPUS_RESET_STATE when they come back. Creating
+// a room or taking on a new speaker therefore costs neither a malloc
+// nor a full codec init.
+//
+// Note that OPUS_RESET_STATE keeps ctl settings (bitrate, DTX, ...);
+// the OpusEncoder/OpusDecoder wrappers re-apply theirs on acquire.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include <opus/opus.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lightvoice {
+
+class OpusStatePool : noncopyable {
+public:
+    // Every slot is large enough for this many channels.
+    static constexpr int kMaxChannels = 2;
+
+    struct Stats {
+        size_t encoders = 0;        // Pooled encoder slots
+        size_t freeEncoders = 0;
+        size_t decoders = 0;        // Pooled decoder slots
+        size_t freeDecoders = 0;
+        size_t heapFallbacks = 0;   // States malloc'ed because the pool was empty
+    };
+
+    static OpusStatePool& instance();
+
+    // Preallocates and initialises `encoders` + `decoders` states for the
+    // given default configuration in one contiguous region. Call at
+    // startup; may be called again to add more capacity.
+    void prewarm(size_t encoders, size_t decoders,
+                 opus_int32 sample_rate = 48000, int channels = 1,
+                 int application = OPUS_APPLICATION_VOIP);
+
+    // Hands out a state configured for (sample_rate, channels). States are
+    // only re-initialised when their previous configuration differs. If the
+    // pool is exhausted a heap-allocated state is created instead.
+    // Throws std::runtime_error if libopus rejects the configuration.
+    ::OpusEncoder* acquireEncoder(opus_int32 sample_rate, int channels, int application);
+    ::OpusDecoder* acquireDecoder(opus_int32 sample_rate, int channels);
+
+    // Resets the state with OPUS_RESET_STATE and returns it to the pool
+    // (or destroys it if it was a heap fallback).
+    void releaseEncoder(::OpusEncoder* encoder);
+    void releaseDecoder(::OpusDecoder* decoder);
+
+    Stats stats();
+
+private:
+    // The configuration a pooled slot was last initialised with.
+    struct SlotConfig {
+        opus_int32 sampleRate = 0;
+        int channels = 0;
+        int application = 0;
+    };
+
+    // One contiguous allocation holding `count` equally sized slots.
+    struct Region {
+        struct Free { void operator()(unsigned char* p) const; };
+        std::unique_ptr<unsigned char, Free> memory;
+        size_t stride = 0;
+        size_t count = 0;
+        std::vector<SlotConfig> configs;
+
+        bool contains(const void* p) const;
+        size_t indexOf(const void* p) const;
+        unsigned char* slot(size_t i) const { return memory.get() + i * stride; }
+    };
+
+    OpusStatePool() = default;
+    ~OpusStatePool() = default;
+
+    static Region makeRegion(size_t slotSize, size_t count);
+    SlotConfig* configOf(std::vector<Region>& regions, const void* state);
+
+    std::mutex mutex_;
+    std::vector<Region> encoderRegions_;
+    std::vector<Region> decoderRegions_;
+    std::vector<::OpusEncoder*> freeEncoders_;
+    std::vector<::OpusDecoder*> freeDecoders_;
+    size_t heapFallbacks_ = 0;
+};
+
+} // namespace lightvoice
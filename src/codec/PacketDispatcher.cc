@@ -0,0 +1,58 @@
+// ====================================================================
+// LightVoice: Packet Dispatcher
+// src/codec/PacketDispatcher.cc
+//
+// Implementation for the PacketDispatcher class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/PacketDispatcher.h"
+#include "common/Logger.h"
+#include "pool/ThreadPool.h"
+#include <memory>
+
+namespace lightvoice {
+
+void PacketDispatcher::registerInline(proto::Packet::PayloadCase payloadCase, Handler handler) {
+    registerRoute(payloadCase, std::move(handler), false);
+}
+
+void PacketDispatcher::registerOffloaded(proto::Packet::PayloadCase payloadCase, Handler handler) {
+    registerRoute(payloadCase, std::move(handler), true);
+}
+
+void PacketDispatcher::registerRoute(proto::Packet::PayloadCase payloadCase, Handler handler, bool offload) {
+    const size_t index = static_cast<size_t>(payloadCase);
+    if (payloadCase == proto::Packet::PAYLOAD_NOT_SET || index >= kMaxCases) {
+        LOGGER_CRITICAL("PacketDispatcher: cannot route payload case {}", index);
+        return;
+    }
+    if (offload && !workers_) {
+        LOGGER_CRITICAL("PacketDispatcher: no worker pool for offloaded payload case {}", index);
+        return;
+    }
+    routes_[index] = Route{std::move(handler), offload};
+}
+
+void PacketDispatcher::dispatch(const net::TcpConnectionPtr& conn, const proto::Packet& packet,
+                                Timestamp receiveTime) const {
+    const size_t index = static_cast<size_t>(packet.payload_case());
+    if (index >= kMaxCases || !routes_[index].handler) {
+        LOGGER_WARN("No handler for payload case {} from {}", index, conn->name());
+        return;
+    }
+
+    const Route& route = routes_[index];
+    if (!route.offload) {
+        route.handler(conn, packet, receiveTime);
+        return;
+    }
+
+    // The packet lives on the codec's arena until the batch ends, so the
+    // worker gets a heap copy.
+    auto copy = std::make_shared<proto::Packet>(packet);
+    workers_->enqueue([handler = route.handler, conn, copy, receiveTime] { handler(conn, *copy, receiveTime); });
+}
+
+} // namespace lightvoice
@@ -0,0 +1,63 @@
+// ====================================================================
+// LightVoice: Packet Dispatcher
+// src/codec/PacketDispatcher.h
+//
+// Routes each control Packet from the ProtobufCodec to its handler by
+// the Packet's oneof case. Handlers sit in a dense table indexed by
+// payload_case(), so dispatch is a bounds check and a load, with no
+// type-name lookup.
+//
+// A handler is registered either inline or offloaded. Inline handlers
+// run on the IO thread that read the packet, saving the two context
+// switches of a worker hop; they must be cheap and never block
+// (heartbeats, room listing). Offloaded handlers run on a worker
+// ThreadPool, for anything slow that needs nothing owned by the IO
+// thread (a login's credential check). They receive their own
+// copy of the packet, since the codec's arena copy only lives for the
+// batch. Unregistered cases are logged and dropped.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include "net/TcpConnection.h"
+#include "proto/chat.pb.h"
+#include <array>
+#include <functional>
+
+namespace lightvoice {
+
+class ThreadPool;
+
+class PacketDispatcher : noncopyable {
+public:
+    using Handler = std::function<void(const net::TcpConnectionPtr&, const proto::Packet&, Timestamp)>;
+
+    // One slot per oneof field number; Packet's cases must stay below it.
+    static constexpr size_t kMaxCases = 32;
+
+    // Offloaded handlers run on `workers`, which must outlive the dispatcher.
+    explicit PacketDispatcher(ThreadPool* workers) : workers_(workers) {}
+
+    // Registration is not thread-safe; finish it before the server starts.
+    void registerInline(proto::Packet::PayloadCase payloadCase, Handler handler);
+    void registerOffloaded(proto::Packet::PayloadCase payloadCase, Handler handler);
+
+    // The codec's message callback, on the IO thread.
+    void dispatch(const net::TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp receiveTime) const;
+
+private:
+    struct Route {
+        Handler handler;
+        bool offload = false;
+    };
+
+    void registerRoute(proto::Packet::PayloadCase payloadCase, Handler handler, bool offload);
+
+    ThreadPool* workers_;
+    std::array<Route, kMaxCases> routes_;
+};
+
+} // namespace lightvoice
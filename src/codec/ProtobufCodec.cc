@@ -8,53 +8,283 @@
 // ====================================================================
 
 #include "codec/ProtobufCodec.h"
+#include "codec/MediaFrame.h"
 #include "common/Logger.h"
+#include "net/EventLoop.h"
+#include "proto/chat.pb.h"
+#include <google/protobuf/arena.h>
 #include <google/protobuf/descriptor.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
 
 namespace lightvoice {
 
+namespace {
+
+// Covers a typical batch (a burst of logins or joins) without the arena
+// going back to the heap.
+constexpr size_t kArenaBlockSize = 64 * 1024;
+
+// Each IO thread runs one EventLoop, so a thread_local arena is a
+// per-loop arena: no locking, and one Reset() frees a whole batch.
+struct LoopArena {
+    LoopArena() : block(new char[kArenaBlockSize]), arena(block.get(), kArenaBlockSize) {}
+
+    std::unique_ptr<char[]> block;
+    google::protobuf::Arena arena;
+};
+
+thread_local LoopArena t_loopArena;
+
+size_t varintSize(uint32_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+char* writeVarint(char* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+// Reads a varint of at most 5 bytes from [p, end). Returns the bytes it
+// took, 0 if it runs past end, or -1 if it is too long to be a uint32.
+int readVarint(const uint8_t* p, const uint8_t* end, uint32_t* value) {
+    uint32_t result = 0;
+    for (int i = 0; i < 5; ++i) {
+        if (p + i == end) {
+            return 0;
+        }
+        result |= static_cast<uint32_t>(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+// Decodes a media frame header from the `len` bytes at p, which start
+// with the tag. Returns the header length, 0 if more bytes are needed,
+// or -1 if the header is malformed.
+int readMediaHeader(const uint8_t* p, size_t len, MediaFrame::Header* header, uint32_t* payloadLen) {
+    const uint8_t* const end = p + len;
+    const uint8_t* cursor = p + 1;
+    uint32_t* const fields[] = {payloadLen, &header->sequence, &header->timestamp, &header->speakerId};
+    for (uint32_t* field : fields) {
+        const int n = readVarint(cursor, end, field);
+        if (n <= 0) {
+            return n;
+        }
+        cursor += n;
+    }
+    if (cursor == end) {
+        return 0;
+    }
+    header->level = *cursor++;
+    return static_cast<int>(cursor - p);
+}
+
+} // namespace
+
 void ProtobufCodec::onMessage(const net::TcpConnectionPtr& conn, net::Buffer* buf, Timestamp receiveTime) {
-    while (buf->readableBytes() >= kHeaderLen) {
+    google::protobuf::Arena& arena = t_loopArena.arena;
+    bool parsed = false;
+    while (buf->readableBytes() > 0) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buf->peek());
+        if (data[0] == kMediaFrameTag) {
+            // Voice: straight into a pooled frame, no protobuf involved.
+            MediaFrame::Header header;
+            uint32_t payloadLen = 0;
+            const int headerLen = readMediaHeader(data, buf->readableBytes(), &header, &payloadLen);
+            if (headerLen < 0 || payloadLen > MediaFrame::kMaxPayload) {
+                LOGGER_ERROR("Invalid media frame, payload length {}", payloadLen);
+                conn->shutdown();
+                break;
+            }
+            if (headerLen == 0 || buf->readableBytes() < headerLen + payloadLen) {
+                break;
+            }
+            MediaFramePtr frame = MediaFrame::acquire();
+            frame->header() = header;
+            frame->assign(data + headerLen, payloadLen);
+            buf->retrieve(headerLen + payloadLen);
+            if (mediaFrameCallback_) {
+                mediaFrameCallback_(conn, std::move(frame), receiveTime);
+            }
+            continue;
+        }
+
+        if (buf->readableBytes() < kHeaderLen) {
+            break;
+        }
         const int32_t len = buf->peekInt32();
-        if (len > 65536 || len < 0) {
+        if (len > kMaxMessageLen || len < 0) {
             LOGGER_ERROR("Invalid length: {}", len);
             conn->shutdown();
             break;
         } else if (buf->readableBytes() >= kHeaderLen + len) {
-            buf->retrieve(kHeaderLen);
-            std::string data = buf->retrieveAsString(len);
-            
             // This is a simplified parsing. A real implementation would have a
             // factory to create the correct message type based on a type name
             // also sent over the wire.
             // For this project, we might just try to parse a generic 'Packet' message.
-            auto packet = std::make_shared<lightvoice::proto::Packet>();
-            if(packet->ParseFromString(data)) {
-                 messageCallback_(conn, packet, receiveTime);
+            // Parsed in place: the arena copies out any strings, so the
+            // bytes can be consumed before the handler runs.
+            auto* packet = google::protobuf::Arena::CreateMessage<proto::Packet>(&arena);
+            parsed = true;
+            const bool ok = packet->ParseFromArray(buf->peek() + kHeaderLen, len);
+            buf->retrieve(kHeaderLen + len);
+            if (ok) {
+                messageCallback_(conn, *packet, receiveTime);
             } else {
                 LOGGER_ERROR("Failed to parse protobuf message");
             }
-
         } else {
             break;
         }
     }
+
+    // Handlers are done with this batch's messages.
+    if (parsed) {
+        arena.Reset();
+    }
+}
+
+void ProtobufCodec::writeFrame(char* out, const google::protobuf::Message& message, size_t bodyLen) {
+    const uint32_t len = static_cast<uint32_t>(bodyLen);
+    out[0] = static_cast<char>(len >> 24);
+    out[1] = static_cast<char>(len >> 16);
+    out[2] = static_cast<char>(len >> 8);
+    out[3] = static_cast<char>(len);
+    message.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(out) + kHeaderLen);
 }
 
 void ProtobufCodec::send(const net::TcpConnectionPtr& conn, const google::protobuf::Message& message) {
-    std::string data;
-    message.SerializeToString(&data);
-    net::Buffer buf;
-    buf.append(data.c_str(), data.size());
-    int32_t len = static_cast<int32_t>(data.size());
-    // Manually perform host-to-big-endian conversion for portability
-    int32_t be32 = 0;
-    be32 |= (len & 0x000000FF) << 24;
-    be32 |= (len & 0x0000FF00) << 8;
-    be32 |= (len & 0x00FF0000) >> 8;
-    be32 |= (len & 0xFF000000) >> 24;
-    buf.prepend(&be32, sizeof(be32));
-    conn->send(&buf);
+    const size_t bodyLen = message.ByteSizeLong();
+    const size_t frameLen = kHeaderLen + bodyLen;
+
+    // On the connection's own loop, serialize straight into its output
+    // buffer: no temporary string, no intermediate Buffer.
+    if (conn->getLoop()->isInLoopThread()) {
+        conn->sendInPlace(frameLen, [&message, bodyLen](char* out) { writeFrame(out, message, bodyLen); });
+        return;
+    }
+
+    // From another thread the message may be gone by the time the loop
+    // runs, so serialize once into a pooled slice (or, for the rare frame
+    // above an MTU, a heap string) and copy that into the output buffer.
+    if (frameLen <= MediaFrame::capacity()) {
+        MediaFramePtr slice = MediaFrame::acquire();
+        writeFrame(reinterpret_cast<char*>(slice->data()), message, bodyLen);
+        slice->setSize(frameLen);
+        conn->getLoop()->queueInLoop([conn, slice] {
+            conn->sendInPlace(slice->size(), [&slice](char* out) { std::memcpy(out, slice->data(), slice->size()); });
+        });
+    } else {
+        auto data = std::make_shared<std::string>(frameLen, '\0');
+        writeFrame(data->data(), message, bodyLen);
+        conn->getLoop()->queueInLoop([conn, data] {
+            conn->sendInPlace(data->size(), [&data](char* out) { std::memcpy(out, data->data(), data->size()); });
+        });
+    }
+}
+
+void ProtobufCodec::broadcast(const std::vector<net::TcpConnectionPtr>& conns,
+                              const google::protobuf::Message& message) {
+    if (conns.empty()) {
+        return;
+    }
+    const size_t bodyLen = message.ByteSizeLong();
+    auto data = std::make_shared<std::string>(kHeaderLen + bodyLen, '\0');
+    writeFrame(data->data(), message, bodyLen);
+    std::shared_ptr<const std::string> payload = std::move(data);
+
+    // There are only a handful of IO loops, so a linear scan groups them.
+    std::vector<std::pair<net::EventLoop*, std::vector<net::TcpConnectionPtr>>> batches;
+    for (const net::TcpConnectionPtr& conn : conns) {
+        auto it = std::find_if(batches.begin(), batches.end(),
+                               [&conn](const auto& batch) { return batch.first == conn->getLoop(); });
+        if (it == batches.end()) {
+            it = batches.emplace(batches.end(), conn->getLoop(), std::vector<net::TcpConnectionPtr>());
+        }
+        it->second.push_back(conn);
+    }
+
+    for (auto& [loop, receivers] : batches) {
+        loop->runInLoop([payload, receivers = std::move(receivers)] {
+            for (const net::TcpConnectionPtr& conn : receivers) {
+                conn->sendInPlace(payload->size(),
+                                  [&payload](char* out) { std::memcpy(out, payload->data(), payload->size()); });
+            }
+        });
+    }
+}
+
+size_t ProtobufCodec::mediaFrameSize(const MediaFrame& frame) {
+    const MediaFrame::Header& header = frame.header();
+    return 1 + varintSize(static_cast<uint32_t>(frame.size())) + varintSize(header.sequence) +
+           varintSize(header.timestamp) + varintSize(header.speakerId) + 1 + frame.size();
+}
+
+void ProtobufCodec::writeMediaFrame(char* out, const MediaFrame& frame) {
+    const MediaFrame::Header& header = frame.header();
+    *out++ = static_cast<char>(kMediaFrameTag);
+    out = writeVarint(out, static_cast<uint32_t>(frame.size()));
+    out = writeVarint(out, header.sequence);
+    out = writeVarint(out, header.timestamp);
+    out = writeVarint(out, header.speakerId);
+    *out++ = static_cast<char>(header.level);
+    std::memcpy(out, frame.data(), frame.size());
+}
+
+namespace {
+
+void writeMedia(const net::TcpConnectionPtr& conn, const MediaFramePtr& frame) {
+    conn->sendInPlace(ProtobufCodec::mediaFrameSize(*frame),
+                      [&frame](char* out) { ProtobufCodec::writeMediaFrame(out, *frame); });
+}
+
+} // namespace
+
+void ProtobufCodec::sendMedia(const net::TcpConnectionPtr& conn, const MediaFramePtr& frame) {
+    if (conn->getLoop()->isInLoopThread()) {
+        writeMedia(conn, frame);
+    } else {
+        conn->getLoop()->queueInLoop([conn, frame] { writeMedia(conn, frame); });
+    }
+}
+
+void ProtobufCodec::sendMediaBatch(net::EventLoop* loop, MediaBatch* batch) {
+    batch->state_.store(MediaBatch::kInFlight, std::memory_order_relaxed);
+    loop->runInLoop([batch] {
+        for (const MediaDelivery& delivery : batch->deliveries) {
+            writeMedia(delivery.conn, delivery.frame);
+        }
+        // The references go on the loop that used them.
+        batch->deliveries.clear();
+        batch->finish();
+    });
+}
+
+void ProtobufCodec::MediaBatch::finish() {
+    if (state_.exchange(kIdle, std::memory_order_acq_rel) == kOrphaned) {
+        delete this;
+    }
+}
+
+void ProtobufCodec::MediaBatch::dispose(MediaBatch* batch) {
+    if (batch->state_.exchange(kOrphaned, std::memory_order_acq_rel) == kIdle) {
+        delete batch;
+    }
 }
 
 } // namespace lightvoice
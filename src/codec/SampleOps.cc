@@ -0,0 +1,391 @@
+// ====================================================================
+// LightVoice: Sample Ops
+// src/codec/SampleOps.cc
+//
+// Implementation of the SampleOps kernels. The SIMD versions are
+// compiled with per-function target attributes, so the rest of the
+// build needs no -m flags and still runs on CPUs without them.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/SampleOps.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIGHTVOICE_SAMPLEOPS_X86 1
+#include <immintrin.h>
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace lightvoice {
+
+namespace {
+
+constexpr float kToFloat = 1.0f / 32768.0f;
+constexpr float kFromFloat = 32768.0f;
+
+// The scalar rounding every SIMD version reproduces: clamp, then round
+// to nearest even.
+inline int16_t saturate(float x) {
+    return static_cast<int16_t>(std::lrintf(std::clamp(x, -32768.0f, 32767.0f)));
+}
+
+// Per-frame gain step of a ramp over `frames` frames.
+inline float rampStep(size_t frames, float from, float to) {
+    return frames ? (to - from) / static_cast<float>(frames) : 0.0f;
+}
+
+// --- Scalar ---
+
+void toFloatScalar(const int16_t* in, float* out, size_t samples) {
+    for (size_t i = 0; i < samples; ++i) {
+        out[i] = static_cast<float>(in[i]) * kToFloat;
+    }
+}
+
+void fromFloatScalar(const float* in, int16_t* out, size_t samples) {
+    for (size_t i = 0; i < samples; ++i) {
+        out[i] = saturate(in[i] * kFromFloat);
+    }
+}
+
+// Samples [begin, end) of a ramp; the SIMD versions finish with it.
+void gainTail(const int16_t* in, int16_t* out, size_t begin, size_t end, int channels, float from, float step) {
+    for (size_t i = begin; i < end; ++i) {
+        const float g = from + step * static_cast<float>(i / static_cast<size_t>(channels));
+        out[i] = saturate(static_cast<float>(in[i]) * g);
+    }
+}
+
+void gainScalar(const int16_t* in, int16_t* out, size_t frames, int channels, float from, float to) {
+    gainTail(in, out, 0, frames * channels, channels, from, rampStep(frames, from, to));
+}
+
+void panScalar(const int16_t* mono, int16_t* stereo, size_t frames, float left, float right) {
+    for (size_t i = 0; i < frames; ++i) {
+        const float s = static_cast<float>(mono[i]);
+        stereo[2 * i] = saturate(s * left);
+        stereo[2 * i + 1] = saturate(s * right);
+    }
+}
+
+void downmixScalar(const int16_t* stereo, int16_t* mono, size_t frames) {
+    for (size_t i = 0; i < frames; ++i) {
+        mono[i] = static_cast<int16_t>((stereo[2 * i] + stereo[2 * i + 1]) >> 1);
+    }
+}
+
+void upmixScalar(const int16_t* mono, int16_t* stereo, size_t frames) {
+    for (size_t i = 0; i < frames; ++i) {
+        stereo[2 * i] = mono[i];
+        stereo[2 * i + 1] = mono[i];
+    }
+}
+
+SampleOps::Meter meterScalar(const int16_t* pcm, size_t samples) {
+    SampleOps::Meter m;
+    for (size_t i = 0; i < samples; ++i) {
+        const int32_t s = pcm[i];
+        m.peak = std::max(m.peak, s < 0 ? -s : s);
+        m.energy += s * s;
+    }
+    return m;
+}
+
+#if defined(LIGHTVOICE_SAMPLEOPS_X86)
+
+// --- SSE4.1 (8 samples per step) ---
+
+TARGET_SSE41 inline __m128i saturateSse(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvtps_epi32(x);
+}
+
+TARGET_SSE41 void toFloatSse(const int16_t* in, float* out, size_t samples) {
+    const __m128 scale = _mm_set1_ps(kToFloat);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(s)), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(s, 8))), scale));
+    }
+    toFloatScalar(in + i, out + i, samples - i);
+}
+
+TARGET_SSE41 void fromFloatSse(const float* in, int16_t* out, size_t samples) {
+    const __m128 scale = _mm_set1_ps(kFromFloat);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i lo = saturateSse(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        const __m128i hi = saturateSse(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+    fromFloatScalar(in + i, out + i, samples - i);
+}
+
+TARGET_SSE41 void gainSse(const int16_t* in, int16_t* out, size_t frames, int channels, float from, float to) {
+    const size_t samples = frames * channels;
+    const float step = rampStep(frames, from, to);
+    const __m128 vfrom = _mm_set1_ps(from);
+    const __m128 vstep = _mm_set1_ps(step);
+    // Frame offset of each lane within a group of 4 samples.
+    const __m128 lanes = channels == 2 ? _mm_setr_ps(0, 0, 1, 1) : _mm_setr_ps(0, 1, 2, 3);
+    const size_t shift = channels == 2 ? 1 : 0;
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128 idx_lo = _mm_add_ps(lanes, _mm_set1_ps(static_cast<float>(i >> shift)));
+        const __m128 idx_hi = _mm_add_ps(lanes, _mm_set1_ps(static_cast<float>((i + 4) >> shift)));
+        const __m128 g_lo = _mm_add_ps(vfrom, _mm_mul_ps(vstep, idx_lo));
+        const __m128 g_hi = _mm_add_ps(vfrom, _mm_mul_ps(vstep, idx_hi));
+        const __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(s)), g_lo);
+        const __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(s, 8))), g_hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(saturateSse(lo), saturateSse(hi)));
+    }
+    gainTail(in, out, i, samples, channels, from, step);
+}
+
+TARGET_SSE41 void panSse(const int16_t* mono, int16_t* stereo, size_t frames, float left, float right) {
+    const __m128 vl = _mm_set1_ps(left);
+    const __m128 vr = _mm_set1_ps(right);
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128i s = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(mono + i));
+        const __m128 f = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(s));
+        const __m128i l = saturateSse(_mm_mul_ps(f, vl));
+        const __m128i r = saturateSse(_mm_mul_ps(f, vr));
+        const __m128i lr = _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(stereo + 2 * i), lr);
+    }
+    panScalar(mono + i, stereo + 2 * i, frames - i, left, right);
+}
+
+TARGET_SSE41 void downmixSse(const int16_t* stereo, int16_t* mono, size_t frames) {
+    const __m128i ones = _mm_set1_epi16(1);
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stereo + 2 * i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stereo + 2 * i + 8));
+        const __m128i sa = _mm_srai_epi32(_mm_madd_epi16(a, ones), 1);
+        const __m128i sb = _mm_srai_epi32(_mm_madd_epi16(b, ones), 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mono + i), _mm_packs_epi32(sa, sb));
+    }
+    downmixScalar(stereo + 2 * i, mono + i, frames - i);
+}
+
+TARGET_SSE41 void upmixSse(const int16_t* mono, int16_t* stereo, size_t frames) {
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(stereo + 2 * i), _mm_unpacklo_epi16(s, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(stereo + 2 * i + 8), _mm_unpackhi_epi16(s, s));
+    }
+    upmixScalar(mono + i, stereo + 2 * i, frames - i);
+}
+
+TARGET_SSE41 SampleOps::Meter meterSse(const int16_t* pcm, size_t samples) {
+    // |-32768| only fits as unsigned, hence the unsigned max; a pair of
+    // squares (up to 2^31) likewise only fits an unsigned 32-bit lane.
+    const __m128i zero = _mm_setzero_si128();
+    __m128i peak = zero;
+    __m128i energy = zero;
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i));
+        peak = _mm_max_epu16(peak, _mm_abs_epi16(s));
+        const __m128i sq = _mm_madd_epi16(s, s);
+        energy = _mm_add_epi64(energy, _mm_unpacklo_epi32(sq, zero));
+        energy = _mm_add_epi64(energy, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    SampleOps::Meter m = meterScalar(pcm + i, samples - i);
+    alignas(16) uint16_t peaks[8];
+    alignas(16) int64_t sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(peaks), peak);
+    _mm_store_si128(reinterpret_cast<__m128i*>(sums), energy);
+    for (uint16_t p : peaks) {
+        m.peak = std::max<int32_t>(m.peak, p);
+    }
+    m.energy += sums[0] + sums[1];
+    return m;
+}
+
+// --- AVX2 (16 samples per step) ---
+// 256-bit packs and unpacks work per 128-bit lane; the permutes put
+// the results back in sample order.
+
+TARGET_AVX2 inline __m256i saturateAvx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f));
+    return _mm256_cvtps_epi32(x);
+}
+
+// Packs two vectors of 8 int32 (samples 0-7, 8-15) into 16 int16 in order.
+TARGET_AVX2 inline __m256i packOrdered(__m256i lo, __m256i hi) {
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+}
+
+TARGET_AVX2 void toFloatAvx2(const int16_t* in, float* out, size_t samples) {
+    const __m256 scale = _mm256_set1_ps(kToFloat);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s)), scale));
+    }
+    toFloatScalar(in + i, out + i, samples - i);
+}
+
+TARGET_AVX2 void fromFloatAvx2(const float* in, int16_t* out, size_t samples) {
+    const __m256 scale = _mm256_set1_ps(kFromFloat);
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        const __m256i lo = saturateAvx2(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale));
+        const __m256i hi = saturateAvx2(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packOrdered(lo, hi));
+    }
+    fromFloatScalar(in + i, out + i, samples - i);
+}
+
+TARGET_AVX2 void gainAvx2(const int16_t* in, int16_t* out, size_t frames, int channels, float from, float to) {
+    const size_t samples = frames * channels;
+    const float step = rampStep(frames, from, to);
+    const __m256 vfrom = _mm256_set1_ps(from);
+    const __m256 vstep = _mm256_set1_ps(step);
+    const __m256 lanes = channels == 2 ? _mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3) : _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const size_t shift = channels == 2 ? 1 : 0;
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256 idx_lo = _mm256_add_ps(lanes, _mm256_set1_ps(static_cast<float>(i >> shift)));
+        const __m256 idx_hi = _mm256_add_ps(lanes, _mm256_set1_ps(static_cast<float>((i + 8) >> shift)));
+        const __m256 g_lo = _mm256_add_ps(vfrom, _mm256_mul_ps(vstep, idx_lo));
+        const __m256 g_hi = _mm256_add_ps(vfrom, _mm256_mul_ps(vstep, idx_hi));
+        const __m256 lo = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(s))), g_lo);
+        const __m256 hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1))), g_hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packOrdered(saturateAvx2(lo), saturateAvx2(hi)));
+    }
+    gainTail(in, out, i, samples, channels, from, step);
+}
+
+TARGET_AVX2 void panAvx2(const int16_t* mono, int16_t* stereo, size_t frames, float left, float right) {
+    const __m256 vl = _mm256_set1_ps(left);
+    const __m256 vr = _mm256_set1_ps(right);
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i));
+        const __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s));
+        const __m256i l = saturateAvx2(_mm256_mul_ps(f, vl));
+        const __m256i r = saturateAvx2(_mm256_mul_ps(f, vr));
+        // Per lane: unpacklo = L0R0L1R1 | L4R4L5R5, unpackhi = L2R2L3R3 |
+        // L6R6L7R7, so the lane-wise pack is already in frame order.
+        const __m256i lr = _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(stereo + 2 * i), lr);
+    }
+    panScalar(mono + i, stereo + 2 * i, frames - i, left, right);
+}
+
+TARGET_AVX2 void downmixAvx2(const int16_t* stereo, int16_t* mono, size_t frames) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    size_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stereo + 2 * i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stereo + 2 * i + 16));
+        const __m256i sa = _mm256_srai_epi32(_mm256_madd_epi16(a, ones), 1);
+        const __m256i sb = _mm256_srai_epi32(_mm256_madd_epi16(b, ones), 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mono + i), packOrdered(sa, sb));
+    }
+    downmixScalar(stereo + 2 * i, mono + i, frames - i);
+}
+
+TARGET_AVX2 void upmixAvx2(const int16_t* mono, int16_t* stereo, size_t frames) {
+    size_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mono + i));
+        const __m256i lo = _mm256_unpacklo_epi16(s, s); // m0-3 | m8-11
+        const __m256i hi = _mm256_unpackhi_epi16(s, s); // m4-7 | m12-15
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(stereo + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(stereo + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    upmixScalar(mono + i, stereo + 2 * i, frames - i);
+}
+
+TARGET_AVX2 SampleOps::Meter meterAvx2(const int16_t* pcm, size_t samples) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i peak = zero;
+    __m256i energy = zero;
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm + i));
+        peak = _mm256_max_epu16(peak, _mm256_abs_epi16(s));
+        const __m256i sq = _mm256_madd_epi16(s, s);
+        energy = _mm256_add_epi64(energy, _mm256_unpacklo_epi32(sq, zero));
+        energy = _mm256_add_epi64(energy, _mm256_unpackhi_epi32(sq, zero));
+    }
+
+    SampleOps::Meter m = meterScalar(pcm + i, samples - i);
+    alignas(32) uint16_t peaks[16];
+    alignas(32) int64_t sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(peaks), peak);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sums), energy);
+    for (uint16_t p : peaks) {
+        m.peak = std::max<int32_t>(m.peak, p);
+    }
+    m.energy += sums[0] + sums[1] + sums[2] + sums[3];
+    return m;
+}
+
+#endif // LIGHTVOICE_SAMPLEOPS_X86
+
+} // namespace
+
+const SampleOps& SampleOps::scalar() {
+    static const SampleOps ops(Isa::kScalar, "scalar", toFloatScalar, fromFloatScalar, gainScalar, panScalar,
+                               downmixScalar, upmixScalar, meterScalar);
+    return ops;
+}
+
+const SampleOps* SampleOps::sse41() {
+#if defined(LIGHTVOICE_SAMPLEOPS_X86)
+    if (__builtin_cpu_supports("sse4.1")) {
+        static const SampleOps ops(Isa::kSse41, "sse4.1", toFloatSse, fromFloatSse, gainSse, panSse,
+                                   downmixSse, upmixSse, meterSse);
+        return &ops;
+    }
+#endif
+    return nullptr;
+}
+
+const SampleOps* SampleOps::avx2() {
+#if defined(LIGHTVOICE_SAMPLEOPS_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        static const SampleOps ops(Isa::kAvx2, "avx2", toFloatAvx2, fromFloatAvx2, gainAvx2, panAvx2,
+                                   downmixAvx2, upmixAvx2, meterAvx2);
+        return &ops;
+    }
+#endif
+    return nullptr;
+}
+
+const SampleOps& SampleOps::instance() {
+    static const SampleOps& ops = avx2() ? *avx2() : sse41() ? *sse41() : scalar();
+    return ops;
+}
+
+const SampleOps* SampleOps::forIsa(Isa isa) {
+    switch (isa) {
+        case Isa::kScalar: return &scalar();
+        case Isa::kSse41:  return sse41();
+        case Isa::kAvx2:   return avx2();
+    }
+    return nullptr;
+}
+
+void SampleOps::panGains(float pan, float* left, float* right) {
+    const float angle = (std::clamp(pan, -1.0f, 1.0f) + 1.0f) * 0.25f * static_cast<float>(M_PI);
+    *left = std::cos(angle);
+    *right = std::sin(angle);
+}
+
+} // namespace lightvoice
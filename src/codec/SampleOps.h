@@ -0,0 +1,98 @@
+// ====================================================================
+// LightVoice: Sample Ops
+// src/codec/SampleOps.h
+//
+// Vectorized kernels for 16-bit PCM: int16 <-> float conversion, gain
+// with a per-frame ramp (so gain changes do not click), mono -> stereo
+// panning, stereo <-> mono down/upmix, and peak/energy metering.
+//
+// Each kernel has a scalar, an SSE4.1 and an AVX2 version; instance()
+// returns the best set the CPU supports, chosen once at first use. All
+// versions produce identical output (float rounding is to nearest, as
+// the SIMD conversions do), so the choice never changes the audio.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace lightvoice {
+
+class SampleOps : noncopyable {
+public:
+    enum class Isa { kScalar, kSse41, kAvx2 };
+
+    struct Meter {
+        int32_t peak = 0;   // Largest |sample|, up to 32768
+        int64_t energy = 0; // Sum of squared samples
+    };
+
+    // The kernels for the best instruction set this CPU supports.
+    static const SampleOps& instance();
+
+    // The kernels for a given instruction set, or nullptr if this CPU
+    // (or build) lacks it. For benchmarks and cross-checks.
+    static const SampleOps* forIsa(Isa isa);
+
+    // Constant-power gains for a pan position from -1 (left) to 1 (right).
+    static void panGains(float pan, float* left, float* right);
+
+    Isa isa() const { return isa_; }
+    const char* name() const { return name_; }
+
+    // Full scale maps to [-1, 1).
+    void toFloat(const int16_t* in, float* out, size_t samples) const { to_float_(in, out, samples); }
+    // Rounds to nearest and saturates.
+    void fromFloat(const float* in, int16_t* out, size_t samples) const { from_float_(in, out, samples); }
+
+    // Scales `frames` interleaved frames of `channels` (1 or 2), ramping
+    // linearly from `from` at the first frame towards `to`. in may equal out.
+    void gain(const int16_t* in, int16_t* out, size_t frames, int channels, float from, float to) const {
+        gain_(in, out, frames, channels, from, to);
+    }
+
+    // Mono -> interleaved stereo with per-side gains (see panGains()).
+    void pan(const int16_t* mono, int16_t* stereo, size_t frames, float left, float right) const {
+        pan_(mono, stereo, frames, left, right);
+    }
+
+    // Interleaved stereo -> mono, the floor of the average of both sides.
+    void downmix(const int16_t* stereo, int16_t* mono, size_t frames) const { downmix_(stereo, mono, frames); }
+    // Mono -> interleaved stereo, the same sample on both sides.
+    void upmix(const int16_t* mono, int16_t* stereo, size_t frames) const { upmix_(mono, stereo, frames); }
+
+    Meter meter(const int16_t* pcm, size_t samples) const { return meter_(pcm, samples); }
+
+private:
+    using ToFloatFn = void (*)(const int16_t*, float*, size_t);
+    using FromFloatFn = void (*)(const float*, int16_t*, size_t);
+    using GainFn = void (*)(const int16_t*, int16_t*, size_t, int, float, float);
+    using PanFn = void (*)(const int16_t*, int16_t*, size_t, float, float);
+    using ChannelFn = void (*)(const int16_t*, int16_t*, size_t);
+    using MeterFn = Meter (*)(const int16_t*, size_t);
+
+    SampleOps(Isa isa, const char* name, ToFloatFn toFloat, FromFloatFn fromFloat, GainFn gain, PanFn pan,
+              ChannelFn downmix, ChannelFn upmix, MeterFn meter)
+        : isa_(isa), name_(name), to_float_(toFloat), from_float_(fromFloat), gain_(gain), pan_(pan),
+          downmix_(downmix), upmix_(upmix), meter_(meter) {}
+
+    static const SampleOps& scalar();
+    static const SampleOps* sse41();
+    static const SampleOps* avx2();
+
+    Isa isa_;
+    const char* name_;
+    ToFloatFn to_float_;
+    FromFloatFn from_float_;
+    GainFn gain_;
+    PanFn pan_;
+    ChannelFn downmix_;
+    ChannelFn upmix_;
+    MeterFn meter_;
+};
+
+} // namespace lightvoice
@@ -0,0 +1,178 @@
+// ====================================================================
+// LightVoice: Voice Activity Detector
+// src/codec/VoiceActivityDetector.cc
+//
+// Implementation of the VoiceActivityDetector class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "codec/VoiceActivityDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lightvoice {
+
+namespace {
+
+// Mean energy of a -60dBov signal, the noise floor a new speaker starts with.
+constexpr int64_t kInitialNoiseFloor = 1074;
+constexpr int64_t kMinNoiseFloor = 1;
+
+uint8_t levelFromMeanEnergy(int64_t energy) {
+    if (energy <= 0) {
+        return 127;
+    }
+    double rms = std::sqrt(static_cast<double>(energy)) / 32768.0;
+    return static_cast<uint8_t>(std::clamp(-20.0 * std::log10(rms), 0.0, 127.0));
+}
+
+// Sum of squares and number of sign changes between a sample and the
+// next sample of the same channel.
+struct Sums {
+    uint64_t energy = 0;
+    uint64_t crossings = 0;
+};
+
+Sums sumsScalar(const int16_t* pcm, size_t begin, size_t samples, size_t stride) {
+    Sums sums;
+    for (size_t i = begin; i < samples; ++i) {
+        sums.energy += static_cast<uint64_t>(static_cast<int32_t>(pcm[i]) * pcm[i]);
+        if (i + stride < samples && ((pcm[i] ^ pcm[i + stride]) < 0)) {
+            ++sums.crossings;
+        }
+    }
+    return sums;
+}
+
+#if defined(__SSE2__)
+Sums sumsSse2(const int16_t* pcm, size_t samples, size_t stride) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i energy = zero;     // 2 x u64
+    __m128i crossings = zero;  // 8 x i16, stays far below overflow per frame
+
+    // Energy and crossings share the loop, so stop where x[i + stride]
+    // would run past the frame.
+    size_t i = 0;
+    for (; i + 8 + stride <= samples; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm + i + stride));
+
+        // a*a summed in pairs; read as unsigned since 2 * 32768^2 only
+        // fits in 32 bits without the sign.
+        __m128i sq = _mm_madd_epi16(a, a);
+        energy = _mm_add_epi64(energy, _mm_unpacklo_epi32(sq, zero));
+        energy = _mm_add_epi64(energy, _mm_unpackhi_epi32(sq, zero));
+
+        // Sign bit of a ^ b is set on a crossing; srai turns it into -1.
+        crossings = _mm_sub_epi16(crossings, _mm_srai_epi16(_mm_xor_si128(a, b), 15));
+    }
+
+    alignas(16) uint64_t e[2];
+    alignas(16) int16_t c[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(e), energy);
+    _mm_store_si128(reinterpret_cast<__m128i*>(c), crossings);
+
+    Sums sums = sumsScalar(pcm, i, samples, stride);
+    sums.energy += e[0] + e[1];
+    for (int16_t n : c) {
+        sums.crossings += static_cast<uint16_t>(n);
+    }
+    return sums;
+}
+#endif
+
+} // namespace
+
+VoiceActivityDetector::VoiceActivityDetector(int frameDurationMs)
+    : hangoverFrames_(std::max(1, kHangoverMs / std::max(1, frameDurationMs))),
+      noiseFloor_(kInitialNoiseFloor),
+      subWindowFrames_(std::max(1, kNoiseWindowMs / kNoiseSubWindows / std::max(1, frameDurationMs))),
+      subWindowMin_(std::numeric_limits<int64_t>::max()) {}
+
+VoiceActivityDetector::Features VoiceActivityDetector::analyze(const int16_t* pcm, size_t samples, int channels) {
+    Features features;
+    if (samples == 0 || channels <= 0) {
+        return features;
+    }
+    const size_t stride = static_cast<size_t>(channels);
+
+#if defined(__SSE2__)
+    Sums sums = sumsSse2(pcm, samples, stride);
+#else
+    Sums sums = sumsScalar(pcm, 0, samples, stride);
+#endif
+
+    features.energy = static_cast<int64_t>(sums.energy / samples);
+    features.level = levelFromMeanEnergy(features.energy);
+    if (samples > stride) {
+        features.zeroCrossingRate = static_cast<float>(sums.crossings) / static_cast<float>(samples - stride);
+    }
+    return features;
+}
+
+bool VoiceActivityDetector::process(const int16_t* pcm, size_t samples, int channels) {
+    Features f = analyze(pcm, samples, channels);
+    trackMinimum(f.energy);
+
+    bool speech = f.level <= kMaxSpeechLevel &&
+                  f.energy > noiseFloor_ * kSnrFactor &&
+                  (f.level <= kLoudLevel || f.zeroCrossingRate < kMaxSpeechZeroCrossingRate);
+
+    if (speech) {
+        hangover_ = hangoverFrames_;
+        // Smooth the level so dominant-speaker ranking does not flap.
+        level_ = active_ ? static_cast<uint8_t>((3 * level_ + f.level) / 4) : f.level;
+    } else {
+        // Track the noise floor: drop to quieter frames at once, rise
+        // slowly so a speaker's own voice does not become "noise".
+        noiseFloor_ = f.energy < noiseFloor_ ? std::max(f.energy, kMinNoiseFloor)
+                                             : noiseFloor_ + (f.energy - noiseFloor_) / 32;
+        if (hangover_ > 0) {
+            --hangover_;
+        }
+    }
+
+    active_ = hangover_ > 0;
+    if (!active_) {
+        level_ = 127;
+    }
+    return active_;
+}
+
+void VoiceActivityDetector::trackMinimum(int64_t energy) {
+    subWindowMin_ = std::min(subWindowMin_, energy);
+    if (++subWindowFrame_ < subWindowFrames_) {
+        return;
+    }
+    subWindowMinima_[subWindow_] = subWindowMin_;
+    subWindow_ = (subWindow_ + 1) % kNoiseSubWindows;
+    fullSubWindows_ = std::min(fullSubWindows_ + 1, static_cast<size_t>(kNoiseSubWindows));
+    subWindowFrame_ = 0;
+    subWindowMin_ = std::numeric_limits<int64_t>::max();
+
+    // Until a whole window has been seen, a talker's first words would
+    // pass for the minimum.
+    if (fullSubWindows_ == kNoiseSubWindows) {
+        const int64_t windowMin = *std::min_element(subWindowMinima_.begin(), subWindowMinima_.end());
+        noiseFloor_ = std::max(noiseFloor_, windowMin);
+    }
+}
+
+void VoiceActivityDetector::reset() {
+    hangover_ = 0;
+    noiseFloor_ = kInitialNoiseFloor;
+    subWindowFrame_ = 0;
+    subWindow_ = 0;
+    fullSubWindows_ = 0;
+    subWindowMin_ = std::numeric_limits<int64_t>::max();
+    active_ = false;
+    level_ = 127;
+}
+
+} // namespace lightvoice
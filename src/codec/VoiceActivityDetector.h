@@ -0,0 +1,90 @@
+// ====================================================================
+// LightVoice: Voice Activity Detector
+// src/codec/VoiceActivityDetector.h
+//
+// A lightweight per-speaker VAD and noise gate that runs on decoded
+// PCM before it is mixed. Each frame is reduced to two features,
+// energy and zero-crossing rate, computed with SSE2 where available.
+// A frame counts as speech when its energy clears both an absolute
+// floor and the speaker's adaptive noise floor, and its zero-crossing
+// rate is not noise-like (loud frames pass regardless, so fricatives
+// are not gated). A hangover keeps the gate open briefly after speech
+// so word endings are not clipped.
+//
+// The noise floor follows quieter frames at once and louder non-speech
+// frames slowly. It also tracks minimum statistics: the quietest frame
+// of the last kNoiseWindowMs, speech or not, is a floor the noise has
+// not dropped below all along. Speech pauses between words, so only
+// steady noise (a hum, a fan) lifts that minimum, and noise the gate
+// first took for speech is learnt within the window rather than never.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace lightvoice {
+
+class VoiceActivityDetector {
+public:
+    // Frames quieter than this (-dBov, RFC 6464) are never speech.
+    static constexpr uint8_t kMaxSpeechLevel = 55;
+    // Frames louder than this are speech whatever their zero-crossing rate.
+    static constexpr uint8_t kLoudLevel = 30;
+    // Speech must be this many times the noise floor's energy (~6dB).
+    static constexpr int64_t kSnrFactor = 4;
+    // Above this crossings-per-sample rate a quiet frame is noise.
+    static constexpr float kMaxSpeechZeroCrossingRate = 0.35f;
+    // How long the gate stays open after the last speech frame.
+    static constexpr int kHangoverMs = 200;
+    // Window of the noise floor's minimum statistics, kept as the minima
+    // of kNoiseSubWindows consecutive parts.
+    static constexpr int kNoiseWindowMs = 1500;
+    static constexpr int kNoiseSubWindows = 5;
+
+    struct Features {
+        int64_t energy = 0;          // Mean squared sample value
+        uint8_t level = 127;         // -dBov, 0 (full scale) to 127 (silence)
+        float zeroCrossingRate = 0;  // Sign changes per sample, per channel
+    };
+
+    explicit VoiceActivityDetector(int frameDurationMs = 20);
+
+    // Computes the features of one interleaved frame of `samples` values.
+    static Features analyze(const int16_t* pcm, size_t samples, int channels);
+
+    // Feeds one frame and returns whether the speaker is active, i.e.
+    // speaking now or within the hangover.
+    bool process(const int16_t* pcm, size_t samples, int channels);
+
+    // Forgets all history, e.g. when the state is handed to a new speaker.
+    void reset();
+
+    bool active() const { return active_; }
+    // Smoothed level of recent speech frames (-dBov), for ranking speakers.
+    uint8_t level() const { return level_; }
+
+private:
+    // Folds a frame's energy into the minimum statistics, and lifts the
+    // noise floor to the window's minimum when a sub-window completes.
+    void trackMinimum(int64_t energy);
+
+    int hangoverFrames_;
+    int hangover_ = 0;
+    int64_t noiseFloor_;
+
+    int subWindowFrames_;
+    int subWindowFrame_ = 0;     // Frames so far in the current part
+    size_t subWindow_ = 0;       // Index of the current part
+    size_t fullSubWindows_ = 0;  // Parts completed since the reset, up to all
+    int64_t subWindowMin_;       // Minimum of the current part
+    std::array<int64_t, kNoiseSubWindows> subWindowMinima_{};
+    bool active_ = false;
+    uint8_t level_ = 127;
+};
+
+} // namespace lightvoice
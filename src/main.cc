@@ -9,34 +9,57 @@
 // ====================================================================
 
 #include "common/Logger.h"
+#include "codec/OpusStatePool.h"
+#include "codec/PacketDispatcher.h"
+#include "codec/ProtobufCodec.h"
 #include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
 #include "net/TcpServer.h"
 #include "net/InetAddress.h"
+#include "pool/ThreadPool.h"
 #include "proto/chat.pb.h"
+#include "room/SignalingHandlers.h"
+#include "room/User.h"
+#include "room/VoiceRoom.h"
+#include "timer/MixScheduler.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace lightvoice;
 using namespace lightvoice::net;
 
+namespace lightvoice {
+// Drives the mix tick of every VoiceRoom; lives on the mixer thread.
+MixScheduler* g_mixScheduler = nullptr;
+// Takes the forked tier encodes of large rooms off the mixer thread.
+ThreadPool* g_encodePool = nullptr;
+// Frames control messages and voice on every connection.
+ProtobufCodec* g_codec = nullptr;
+}
+
 // A simple connection callback
 void onConnection(const TcpConnectionPtr& conn) {
     if (conn->connected()) {
         LOGGER_INFO("New connection {} from {}", conn->name(), conn->peerAddress().toIpPort());
     } else {
         LOGGER_INFO("Connection {} is down", conn->name());
+        // A dropped connection leaves its room, and ends its session: the
+        // User holds the connection, so the context must let go of it.
+        UserPtr user = sessionUser(conn);
+        if (VoiceRoomPtr room = user ? user->room() : nullptr) {
+            room->removeUser(user);
+        }
+        conn->setContext(std::any());
     }
 }
 
-// A simple message callback (just logs the message)
-void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp time) {
-    LOGGER_DEBUG("Received {} bytes from {}", buf->readableBytes(), conn->name());
-    
-    // For now, just retrieve all data to clear the buffer
-    std::string msg = buf->retrieveAllAsString();
-    LOGGER_INFO("Message content: {}", msg);
-
-    // In a real app, you would parse the protobuf message here
-    // e.g., using the ProtobufCodec
+// Voice goes straight to the sender's room, on this IO thread.
+void onMediaFrame(const TcpConnectionPtr& conn, MediaFramePtr frame, Timestamp) {
+    // Voice before login, or outside a room, is dropped.
+    UserPtr user = sessionUser(conn);
+    if (VoiceRoomPtr room = user ? user->room() : nullptr) {
+        room->onAudioPacket(user->id(), std::move(frame));
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -51,18 +74,52 @@ int main(int argc, char* argv[]) {
     }
     LOGGER_INFO("Listening on port {}", port);
 
+    // Pre-warm the codec state pool: one encoder and a decoder per room
+    // for the 500-room target, plus headroom for per-speaker decoders.
+    OpusStatePool::instance().prewarm(512, 1024);
+
     // The main event loop
     EventLoop loop;
 
+    // Encode workers: rooms only fork onto them once their serial tier
+    // encodes take a large share of the tick. Declared before the mixer
+    // thread so it outlives every tick.
+    ThreadPool encodePool(std::max(2u, std::thread::hardware_concurrency() / 4));
+    g_encodePool = &encodePool;
+
+    // The mixer thread: a dedicated loop whose only job is the room mix ticks
+    EventLoopThread mixerThread;
+    MixScheduler mixScheduler(mixerThread.startLoop());
+    g_mixScheduler = &mixScheduler;
+
     // The server address
     InetAddress listenAddr(port);
 
     // The TcpServer
     TcpServer server(&loop, listenAddr, "LightVoiceServer");
 
+    // Workers for the control work that does not belong on an IO
+    // thread (logins, building new rooms).
+    ThreadPool workerPool(std::max(2u, std::thread::hardware_concurrency() / 2));
+
+    // Control messages are routed by their Packet case; cheap ones are
+    // handled inline on the IO thread that read them.
+    PacketDispatcher dispatcher(&workerPool);
+    registerSignalingHandlers(dispatcher, &workerPool);
+
+    // One codec for every connection: protobuf control messages and
+    // binary voice frames on the same stream.
+    ProtobufCodec codec([&dispatcher](const TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp time) {
+        dispatcher.dispatch(conn, packet, time);
+    });
+    codec.setMediaFrameCallback(onMediaFrame);
+    g_codec = &codec;
+
     // Set callbacks
     server.setConnectionCallback(onConnection);
-    server.setMessageCallback(onMessage);
+    server.setMessageCallback([&codec](const TcpConnectionPtr& conn, Buffer* buf, Timestamp time) {
+        codec.onMessage(conn, buf, time);
+    });
 
     // Set the number of I/O threads
     server.setThreadNum(4); // e.g., 4 IO threads
@@ -15,6 +15,7 @@
 #include <string>
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 
 namespace lightvoice {
 namespace net {
@@ -35,6 +36,14 @@ public:
 
     const char* peek() const { return begin() + readerIndex_; }
 
+    // Reads a big-endian int32 at peek() without consuming it.
+    int32_t peekInt32() const {
+        assert(readableBytes() >= sizeof(int32_t));
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(peek());
+        return static_cast<int32_t>((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                                    (uint32_t(p[2]) << 8) | uint32_t(p[3]));
+    }
+
     void retrieve(size_t len) {
         assert(len <= readableBytes());
         if (len < readableBytes()) {
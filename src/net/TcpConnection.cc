@@ -99,6 +99,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
         nwrote = ::write(sockfd_, data, len);
         if (nwrote >= 0) {
+            bytesSent_.fetch_add(static_cast<uint64_t>(nwrote), std::memory_order_relaxed);
             remaining = len - nwrote;
             if (remaining == 0) {
                 // Wrote everything
@@ -116,12 +117,43 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
 
     if (!faultError && remaining > 0) {
         outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
+        outputBacklog_.store(outputBuffer_.readableBytes(), std::memory_order_relaxed);
         if (!channel_->isWriting()) {
             channel_->enableWriting();
         }
     }
 }
 
+void TcpConnection::sendInPlace(size_t len, const FillCallback& fill) {
+    loop_->assertInLoopThread();
+    if (state_ != kConnected) {
+        return;
+    }
+
+    outputBuffer_.ensureWritableBytes(len);
+    fill(outputBuffer_.beginWrite());
+    outputBuffer_.hasWritten(len);
+
+    // Nothing was pending (the buffer drains fully before writing is
+    // disabled), so try the socket right away like sendInLoop.
+    if (!channel_->isWriting()) {
+        ssize_t nwrote = ::write(sockfd_, outputBuffer_.peek(), outputBuffer_.readableBytes());
+        if (nwrote >= 0) {
+            outputBuffer_.retrieve(nwrote);
+            bytesSent_.fetch_add(static_cast<uint64_t>(nwrote), std::memory_order_relaxed);
+        } else if (errno != EWOULDBLOCK) {
+            LOGGER_ERROR("TcpConnection::sendInPlace");
+            if (errno == EPIPE || errno == ECONNRESET) {
+                outputBuffer_.retrieveAll();
+            }
+        }
+        if (outputBuffer_.readableBytes() > 0) {
+            channel_->enableWriting();
+        }
+    }
+    outputBacklog_.store(outputBuffer_.readableBytes(), std::memory_order_relaxed);
+}
+
 void TcpConnection::shutdown() {
     if (state_ == kConnected) {
         setState(kDisconnecting);
@@ -178,6 +210,8 @@ void TcpConnection::handleWrite() {
         ssize_t n = ::write(sockfd_, outputBuffer_.peek(), outputBuffer_.readableBytes());
         if (n > 0) {
             outputBuffer_.retrieve(n);
+            bytesSent_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+            outputBacklog_.store(outputBuffer_.readableBytes(), std::memory_order_relaxed);
             if (outputBuffer_.readableBytes() == 0) {
                 channel_->disableWriting();
                 if (state_ == kDisconnecting) {
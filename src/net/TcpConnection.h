@@ -15,6 +15,7 @@
 
 #include "common/noncopyable.h"
 #include "net/Buffer.h"
+#include <atomic>
 #include <memory>
 #include <functional>
 #include <any>
@@ -42,6 +43,8 @@ using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
 using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*, Timestamp)>;
+// Writes exactly the reserved number of bytes at the given address.
+using FillCallback = std::function<void(char*)>;
 
 
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection> {
@@ -64,9 +67,21 @@ public:
     void send(const std::string& message);
     void send(Buffer* message); // Takes ownership
 
+    // Reserves `len` bytes at the end of the output buffer and lets `fill`
+    // write the message straight into them, then flushes as send() does.
+    // Saves the copy through a temporary. Must be called in the loop thread.
+    void sendInPlace(size_t len, const FillCallback& fill);
+
     // Shutdown connection
     void shutdown();
 
+    // Send-queue statistics, readable from any thread. The backlog is what
+    // is waiting in the output buffer for the socket to drain; bytesSent
+    // counts what the socket has accepted so far. Sampled over time they
+    // give the connection's drain rate.
+    size_t outputBacklog() const { return outputBacklog_.load(std::memory_order_relaxed); }
+    uint64_t bytesSent() const { return bytesSent_.load(std::memory_order_relaxed); }
+
     // Setters for callbacks
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
@@ -109,6 +124,8 @@ private:
 
     Buffer inputBuffer_;
     Buffer outputBuffer_;
+    std::atomic<size_t> outputBacklog_{0};
+    std::atomic<uint64_t> bytesSent_{0};
 
     std::any context_;
 };
@@ -0,0 +1,152 @@
+// ====================================================================
+// LightVoice: Slab Pool
+// src/pool/SlabPool.h
+//
+// A thread-safe pool of fixed-size objects carved out of large slabs.
+// Unlike ObjectPool it hands out raw pointers and never frees or
+// re-constructs objects: callers reset what they need, and the pool
+// only grows (one slab at a time) when every object is in use.
+//
+// acquire() and release() take no lock. Free objects form a stack
+// linked by index: each slab keeps a next-index word per object, and
+// the head packs the top index with a tag bumped on every change, so a
+// compare-and-swap cannot succeed against a head that was popped and
+// pushed back in between (ABA). Objects are released on other threads
+// than the ones that acquired them (a packet is pooled by an IO thread
+// and let go by the mixer), which a single shared stack handles without
+// per-thread caches to rebalance. Only growing takes a mutex.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace lightvoice {
+
+template <typename T, size_t SlabSize = 256>
+class SlabPool : noncopyable {
+public:
+    // The pool stops growing here; acquire() then throws std::bad_alloc.
+    static constexpr size_t kMaxSlabs = 256;
+    static_assert(kMaxSlabs * SlabSize < UINT32_MAX, "object indices are 32 bits");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the free-list head needs a lock-free 64-bit CAS");
+
+    // Constructor: pre-allocates a certain number of slabs
+    explicit SlabPool(size_t initialSlabs = 0) {
+        std::lock_guard<std::mutex> lock(grow_mutex_);
+        for (size_t i = 0; i < initialSlabs; ++i) {
+            grow();
+        }
+    }
+
+    ~SlabPool() {
+        for (auto& slab : slabs_) {
+            delete slab.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Get an object from the pool, growing it by one slab if empty
+    T* acquire() {
+        for (;;) {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            while (indexOf(head) != kEmpty) {
+                // The link may be stale if another thread popped this
+                // object meanwhile; the tag then fails the exchange.
+                const uint32_t next = link(indexOf(head)).load(std::memory_order_relaxed);
+                if (head_.compare_exchange_weak(head, pack(next, tagOf(head) + 1), std::memory_order_acquire,
+                                                std::memory_order_acquire)) {
+                    return &object(indexOf(head));
+                }
+            }
+            refill();
+        }
+    }
+
+    // Return an object previously obtained from acquire()
+    void release(T* obj) {
+        const uint32_t index = indexOf(obj);
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        do {
+            link(index).store(indexOf(head), std::memory_order_relaxed);
+        } while (!head_.compare_exchange_weak(head, pack(index, tagOf(head) + 1), std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    size_t capacity() const {
+        return slab_count_.load(std::memory_order_acquire) * SlabSize;
+    }
+
+private:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    struct Slab {
+        T objects[SlabSize];
+        std::atomic<uint32_t> next[SlabSize]; // Free-list link of each object
+    };
+
+    static constexpr uint64_t pack(uint32_t index, uint32_t tag) { return (static_cast<uint64_t>(tag) << 32) | index; }
+    static uint32_t indexOf(uint64_t head) { return static_cast<uint32_t>(head); }
+    static uint32_t tagOf(uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+
+    Slab& slab(uint32_t index) { return *slabs_[index / SlabSize].load(std::memory_order_acquire); }
+    T& object(uint32_t index) { return slab(index).objects[index % SlabSize]; }
+    std::atomic<uint32_t>& link(uint32_t index) { return slab(index).next[index % SlabSize]; }
+
+    // The object's index: a walk over the slabs, of which a pool has few.
+    uint32_t indexOf(const T* obj) const {
+        const size_t count = slab_count_.load(std::memory_order_acquire);
+        const auto address = reinterpret_cast<uintptr_t>(obj);
+        for (size_t s = 0; s < count; ++s) {
+            const auto first = reinterpret_cast<uintptr_t>(slabs_[s].load(std::memory_order_relaxed)->objects);
+            if (address - first < SlabSize * sizeof(T)) {
+                return static_cast<uint32_t>(s * SlabSize + (address - first) / sizeof(T));
+            }
+        }
+        std::abort(); // Not from this pool
+    }
+
+    // Grows the pool unless objects came back while waiting for the lock.
+    void refill() {
+        std::lock_guard<std::mutex> lock(grow_mutex_);
+        if (indexOf(head_.load(std::memory_order_acquire)) == kEmpty) {
+            grow();
+        }
+    }
+
+    void grow() {
+        const size_t count = slab_count_.load(std::memory_order_relaxed);
+        if (count == kMaxSlabs) {
+            throw std::bad_alloc();
+        }
+        Slab* slab = new Slab();
+        const auto first = static_cast<uint32_t>(count * SlabSize);
+        for (size_t i = 0; i + 1 < SlabSize; ++i) {
+            slab->next[i].store(static_cast<uint32_t>(first + i + 1), std::memory_order_relaxed);
+        }
+        slabs_[count].store(slab, std::memory_order_release);
+        slab_count_.store(count + 1, std::memory_order_release);
+
+        // Push the whole slab as one chain onto whatever is free by now.
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        do {
+            slab->next[SlabSize - 1].store(indexOf(head), std::memory_order_relaxed);
+        } while (!head_.compare_exchange_weak(head, pack(first, tagOf(head) + 1), std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    alignas(64) std::atomic<uint64_t> head_{pack(kEmpty, 0)};
+    alignas(64) std::array<std::atomic<Slab*>, kMaxSlabs> slabs_{};
+    std::atomic<size_t> slab_count_{0};
+    std::mutex grow_mutex_; // Serializes grow()
+};
+
+} // namespace lightvoice
@@ -0,0 +1,106 @@
+// ====================================================================
+// LightVoice: SPSC Ring
+// src/pool/SpscRing.h
+//
+// A bounded, wait-free single-producer / single-consumer ring buffer.
+// Slots are preallocated (copies of a prototype) and handed out in
+// place, so a producer can decode or copy straight into the next slot
+// and the consumer can read it without any copy or allocation:
+//
+//   T* slot = ring.beginWrite();   // producer thread
+//   if (slot) { fill(*slot); ring.commitWrite(); }
+//
+//   T* item = ring.front();        // consumer thread
+//   if (item) { use(*item); ring.pop(); }
+//
+// Exactly one thread may produce and one may consume at a time.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace lightvoice {
+
+template <typename T>
+class SpscRing : noncopyable {
+public:
+    // capacity is rounded up to a power of two.
+    explicit SpscRing(size_t capacity, const T& prototype = T())
+        : slots_(roundUpPow2(capacity), prototype),
+          mask_(slots_.size() - 1) {}
+
+    // --- Producer ---
+
+    // Next free slot, or nullptr if the ring is full.
+    T* beginWrite() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // Publishes the slot returned by beginWrite().
+    void commitWrite() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool push(const T& value) {
+        T* slot = beginWrite();
+        if (!slot) {
+            return false;
+        }
+        *slot = value;
+        commitWrite();
+        return true;
+    }
+
+    // --- Consumer ---
+
+    // Oldest published slot, or nullptr if the ring is empty.
+    T* front() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+
+    // Releases the slot returned by front() back to the producer.
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // --- Either side (a snapshot) ---
+
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    std::vector<T> slots_;
+    const size_t mask_;
+
+    // Each index on its own cache line so producer and consumer do not
+    // false-share.
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to read
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to write
+};
+
+} // namespace lightvoice
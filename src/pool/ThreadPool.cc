@@ -19,19 +19,42 @@ ThreadPool::ThreadPool(size_t numThreads) {
             LOGGER_DEBUG("Worker thread {} starting.", i);
             while (true) {
                 std::function<void()> task;
+                Job* job = nullptr;
                 {
                     std::unique_lock<std::mutex> lock(this->queue_mutex_);
                     this->condition_.wait(lock, [this] {
-                        return this->stop_ || !this->tasks_.empty();
+                        return this->stop_ || this->hasWork();
                     });
 
-                    if (this->stop_ && this->tasks_.empty()) {
+                    if (this->stop_ && !this->hasWork()) {
                         LOGGER_DEBUG("Worker thread {} stopping.", i);
                         return;
                     }
 
-                    task = std::move(this->tasks_.front());
-                    this->tasks_.pop();
+                    if (this->jobs_head_) {
+                        job = this->jobs_head_;
+                        this->jobs_head_ = job->next;
+                        if (!this->jobs_head_) {
+                            this->jobs_tail_ = nullptr;
+                        }
+                        job->next = nullptr;
+                        job->state = Job::kRunning;
+                    } else {
+                        task = std::move(this->tasks_.front());
+                        this->tasks_.pop();
+                    }
+                }
+                if (job) {
+                    // Jobs are on hot paths and must not throw.
+                    job->run(*job);
+                    {
+                        // The job may be destroyed as soon as its waiter
+                        // sees kDone; the notify below is on the pool.
+                        std::lock_guard<std::mutex> lock(this->queue_mutex_);
+                        job->state = Job::kDone;
+                    }
+                    this->jobs_done_.notify_all();
+                    continue;
                 }
                 try {
                     task();
@@ -45,6 +68,48 @@ ThreadPool::ThreadPool(size_t numThreads) {
     }
 }
 
+bool ThreadPool::submit(Job& job) {
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (stop_) {
+            return false;
+        }
+        job.next = nullptr;
+        job.state = Job::kQueued;
+        if (jobs_tail_) {
+            jobs_tail_->next = &job;
+        } else {
+            jobs_head_ = &job;
+        }
+        jobs_tail_ = &job;
+    }
+    condition_.notify_one();
+    return true;
+}
+
+bool ThreadPool::cancel(Job& job) {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    if (job.state != Job::kQueued) {
+        return false;
+    }
+    Job* prev = nullptr;
+    for (Job* it = jobs_head_; it != &job; it = it->next) {
+        prev = it;
+    }
+    (prev ? prev->next : jobs_head_) = job.next;
+    if (jobs_tail_ == &job) {
+        jobs_tail_ = prev;
+    }
+    job.next = nullptr;
+    job.state = Job::kIdle;
+    return true;
+}
+
+void ThreadPool::wait(Job& job) {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    jobs_done_.wait(lock, [&job] { return job.state != Job::kQueued && job.state != Job::kRunning; });
+}
+
 ThreadPool::~ThreadPool() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
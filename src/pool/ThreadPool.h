@@ -5,6 +5,14 @@
 // A C++20 thread pool for executing tasks asynchronously. It's
 // useful for offloading work from critical I/O threads.
 //
+// enqueue() wraps any callable in a packaged task and returns its
+// future, which allocates per call. Hot paths instead submit a Job they
+// own and reuse: it is linked into the queue as is, and the caller joins
+// it with wait(), so a submit allocates nothing. A job's state changes
+// only under the pool's mutex, and completion is signalled on the pool's
+// own condition variable: once wait() returns, no worker touches the job
+// again, and its owner may destroy it.
+//
 // Author: Gemini
 // ====================================================================
 
@@ -30,12 +38,39 @@ public:
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::invoke_result_t<F, Args...>>;
 
+    // A caller-owned task. It must not be destroyed while queued or
+    // running, and be submitted again only once it is done or cancelled.
+    struct Job {
+        enum State { kIdle, kQueued, kRunning, kDone };
+
+        void (*run)(Job& job) = nullptr;
+        // Guarded by the pool's mutex.
+        State state = kIdle;
+        Job* next = nullptr; // Queue link
+    };
+
+    // Queues the job ahead of enqueued tasks. Returns false, leaving the
+    // job idle, once the pool is stopping.
+    bool submit(Job& job);
+
+    // Takes back a job no worker has started. Returns false if a worker
+    // already has it (wait() for it then) or it was never queued.
+    bool cancel(Job& job);
+
+    // Blocks until a worker has finished the job, if it was queued.
+    void wait(Job& job);
+
 private:
+    bool hasWork() const { return !tasks_.empty() || jobs_head_; }
+
     std::vector<std::thread> workers_;
     std::queue<std::function<void()>> tasks_;
+    Job* jobs_head_ = nullptr;
+    Job* jobs_tail_ = nullptr;
 
     std::mutex queue_mutex_;
     std::condition_variable condition_;
+    std::condition_variable jobs_done_; // Signalled as jobs finish
     bool stop_ = false;
 };
 
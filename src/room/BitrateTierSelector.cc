@@ -0,0 +1,52 @@
+// ====================================================================
+// LightVoice: Bitrate Tier Selector
+// src/room/BitrateTierSelector.cc
+//
+// Implementation of the BitrateTierSelector class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "room/BitrateTierSelector.h"
+#include <algorithm>
+
+namespace lightvoice {
+
+int BitrateTierSelector::update(size_t backlogBytes, uint64_t bytesSent, int64_t intervalUs,
+                                const int32_t* tierBitrates, int numTiers) {
+    const uint64_t sent = bytesSent - lastBytesSent_;
+    lastBytesSent_ = bytesSent;
+    // The first sample only establishes the baseline.
+    if (!primed_ || intervalUs <= 0 || numTiers <= 0) {
+        primed_ = true;
+        return tier_;
+    }
+    tier_ = std::min(tier_, numTiers - 1);
+
+    const double drainBps = static_cast<double>(sent) * 8.0 * 1e6 / static_cast<double>(intervalUs);
+    const double maxBacklogBytes = tierBitrates[tier_] / 8.0 * kMaxBacklogMs / 1000.0;
+
+    if (static_cast<double>(backlogBytes) > maxBacklogBytes) {
+        // Congested: drop to the best tier the link drained, and at least
+        // one step so the backlog can shrink.
+        int target = numTiers - 1;
+        for (int t = 0; t < numTiers; ++t) {
+            if (tierBitrates[t] <= drainBps * kHeadroom) {
+                target = t;
+                break;
+            }
+        }
+        tier_ = std::max(target, std::min(tier_ + 1, numTiers - 1));
+        cleanEvaluations_ = 0;
+    } else if (backlogBytes == 0 && tier_ > 0) {
+        if (++cleanEvaluations_ >= kUpgradeEvaluations) {
+            --tier_;
+            cleanEvaluations_ = 0;
+        }
+    } else {
+        cleanEvaluations_ = 0;
+    }
+    return tier_;
+}
+
+} // namespace lightvoice
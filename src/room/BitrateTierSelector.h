@@ -0,0 +1,49 @@
+// ====================================================================
+// LightVoice: Bitrate Tier Selector
+// src/room/BitrateTierSelector.h
+//
+// Picks which rung of a room's bitrate ladder a listener receives,
+// from their connection's measured send-queue drain rate. A listener
+// whose output backlog grows past what their tier should queue is
+// moved down to the best tier the link actually drained; a listener
+// whose queue stays empty for a while is moved back up one tier at a
+// time. Tier 0 is the highest bitrate.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lightvoice {
+
+class BitrateTierSelector {
+public:
+    // A backlog worth more than this much audio at the current tier's
+    // bitrate means the link is not keeping up.
+    static constexpr int kMaxBacklogMs = 200;
+    // A lower tier must fit in this fraction of the measured drain rate,
+    // leaving room for framing and TCP overhead.
+    static constexpr double kHeadroom = 0.8;
+    // Consecutive uncongested evaluations before trying a better tier.
+    static constexpr int kUpgradeEvaluations = 5;
+
+    // Re-evaluates the tier from the connection's current output backlog
+    // and total bytes sent, `intervalUs` after the previous call.
+    // tierBitrates holds numTiers bitrates, highest first.
+    // Returns the (possibly new) tier.
+    int update(size_t backlogBytes, uint64_t bytesSent, int64_t intervalUs,
+               const int32_t* tierBitrates, int numTiers);
+
+    int tier() const { return tier_; }
+
+private:
+    int tier_ = 0;
+    int cleanEvaluations_ = 0;
+    uint64_t lastBytesSent_ = 0;
+    bool primed_ = false;
+};
+
+} // namespace lightvoice
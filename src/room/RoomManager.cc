@@ -8,44 +8,129 @@
 // ====================================================================
 
 #include "room/RoomManager.h"
+#include "codec/FrameBundler.h"
+#include "common/Logger.h"
+#include "proto/chat.pb.h"
+#include <algorithm>
 
 namespace lightvoice {
 
+AudioConfig audioConfigFromRequest(const proto::CreateRoomRequest& request) {
+    AudioConfig config;
+    if (request.sample_rate() != 0) {
+        config.sampleRate = static_cast<opus_int32>(request.sample_rate());
+    }
+    if (request.channels() != 0) {
+        config.channels = static_cast<int>(request.channels());
+    }
+    if (request.frame_duration_ms() != 0) {
+        config.frameDurationMs = static_cast<int>(request.frame_duration_ms());
+    }
+    return config;
+}
+
+int bundleFramesFromRequest(const proto::JoinRoomRequest& request) {
+    if (request.bundle_frames() < static_cast<uint32_t>(FrameBundler::kMinFrames)) {
+        return 1;
+    }
+    return static_cast<int>(std::min<uint32_t>(request.bundle_frames(), FrameBundler::kMaxFrames));
+}
+
 RoomManager& RoomManager::instance() {
     static RoomManager instance;
     return instance;
 }
 
-VoiceRoomPtr RoomManager::createRoom(const std::string& name, UserPtr owner) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    uint32_t id = next_room_id_++;
-    auto room = std::make_shared<VoiceRoom>(id, name, owner);
-    rooms_[id] = room;
+VoiceRoomPtr RoomManager::createRoom(const std::string& name, UserPtr owner, const AudioConfig& config) {
+    if (!config.valid()) {
+        LOGGER_WARN("Rejecting room {}: unsupported audio config {}Hz {}ch {}ms",
+                    name, config.sampleRate, config.channels, config.frameDurationMs);
+        return nullptr;
+    }
+
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        id = next_room_id_++;
+    }
+
+    // Building the room's codecs is the slow part; no lock is held for it.
+    VoiceRoomPtr room;
+    try {
+        room = std::make_shared<VoiceRoom>(id, name, owner, config);
+    } catch (const std::exception& e) {
+        LOGGER_ERROR("Failed to create room {} ({}): {}", name, id, e.what());
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto rooms = snapshot_.load(std::memory_order_acquire)->rooms;
+        auto it = std::lower_bound(rooms.begin(), rooms.end(), id,
+                                   [](const auto& entry, uint32_t key) { return entry.first < key; });
+        rooms.emplace(it, id, room);
+        publish(std::move(rooms));
+    }
+    room->start();
     return room;
 }
 
 VoiceRoomPtr RoomManager::findRoom(uint32_t id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = rooms_.find(id);
-    if (it != rooms_.end()) {
+    const Snapshot& snapshot = readSnapshot();
+    auto it = std::lower_bound(snapshot.rooms.begin(), snapshot.rooms.end(), id,
+                               [](const auto& entry, uint32_t key) { return entry.first < key; });
+    if (it != snapshot.rooms.end() && it->first == id) {
         return it->second;
     }
     return nullptr;
 }
 
 void RoomManager::destroyRoom(uint32_t id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    rooms_.erase(id);
+    VoiceRoomPtr room;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto rooms = snapshot_.load(std::memory_order_acquire)->rooms;
+        auto it = std::lower_bound(rooms.begin(), rooms.end(), id,
+                                   [](const auto& entry, uint32_t key) { return entry.first < key; });
+        if (it == rooms.end() || it->first != id) {
+            return;
+        }
+        room = std::move(it->second);
+        rooms.erase(it);
+        publish(std::move(rooms));
+    }
+    room->stop();
 }
 
 std::vector<VoiceRoomPtr> RoomManager::listRooms() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    const Snapshot& snapshot = readSnapshot();
     std::vector<VoiceRoomPtr> list;
-    list.reserve(rooms_.size());
-    for(const auto& pair : rooms_) {
-        list.push_back(pair.second);
+    list.reserve(snapshot.rooms.size());
+    for (const auto& entry : snapshot.rooms) {
+        list.push_back(entry.second);
     }
     return list;
 }
 
+const RoomManager::Snapshot& RoomManager::readSnapshot() {
+    // One cache per thread is enough for a singleton. Only a change in
+    // the published version costs this thread a (briefly locked) reload.
+    thread_local SnapshotPtr cached;
+    if (!cached || cached->version != version_.load(std::memory_order_acquire)) {
+        cached = snapshot_.load(std::memory_order_acquire);
+    }
+    return *cached;
+}
+
+void RoomManager::publish(std::vector<std::pair<uint32_t, VoiceRoomPtr>> rooms) {
+    auto next = std::make_shared<Snapshot>();
+    next->version = version_.load(std::memory_order_relaxed) + 1;
+    next->rooms = std::move(rooms);
+    const uint64_t version = next->version;
+    // The snapshot goes out before its version, so a reader that sees the
+    // new version also loads the new snapshot.
+    snapshot_.store(std::move(next), std::memory_order_release);
+    version_.store(version, std::memory_order_release);
+}
+
 } // namespace lightvoice
@@ -5,6 +5,16 @@
 // A singleton manager for all voice rooms. It handles creating,
 // finding, and destroying rooms.
 //
+// Lookups vastly outnumber changes (every control message and every
+// audio packet may look a room up; rooms come and go a few times a
+// minute), so the rooms live in an immutable snapshot, a flat vector
+// sorted by id. Create and destroy copy it, change the copy and publish
+// it under a writer-only mutex. Each reader thread caches the current
+// snapshot and only reloads it when the published version moves on, so
+// findRoom() and listRooms() take no lock and write no shared memory
+// beyond the returned room's reference count. A destroyed room's memory
+// is freed once every thread that cached it has looked up again.
+//
 // Author: Gemini
 // ====================================================================
 
@@ -12,27 +22,59 @@
 
 #include "common/noncopyable.h"
 #include "room/VoiceRoom.h"
-#include <map>
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace lightvoice {
 
+namespace proto {
+class CreateRoomRequest;
+class JoinRoomRequest;
+}
+
+// Builds a room's audio config from a create request; unset fields take
+// the server defaults.
+AudioConfig audioConfigFromRequest(const proto::CreateRoomRequest& request);
+
+// Frames per packet a joining listener asked for, clamped to what the
+// FrameBundler supports (1 = no bundling).
+int bundleFramesFromRequest(const proto::JoinRoomRequest& request);
+
 class RoomManager : noncopyable {
 public:
     static RoomManager& instance();
 
-    VoiceRoomPtr createRoom(const std::string& name, UserPtr owner);
+    // Returns nullptr if the audio config is unsupported or the room's
+    // codecs could not be created.
+    VoiceRoomPtr createRoom(const std::string& name, UserPtr owner,
+                            const AudioConfig& config = AudioConfig());
     VoiceRoomPtr findRoom(uint32_t id);
     void destroyRoom(uint32_t id);
     
     std::vector<VoiceRoomPtr> listRooms();
 
 private:
+    struct Snapshot {
+        uint64_t version = 0;
+        std::vector<std::pair<uint32_t, VoiceRoomPtr>> rooms; // Sorted by id
+    };
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
     RoomManager() = default;
     ~RoomManager() = default;
 
-    std::mutex mutex_;
-    std::map<uint32_t, VoiceRoomPtr> rooms_;
+    // The calling thread's cached snapshot, reloaded if it is stale.
+    const Snapshot& readSnapshot();
+    // Publishes `rooms` as the next snapshot; requires write_mutex_.
+    void publish(std::vector<std::pair<uint32_t, VoiceRoomPtr>> rooms);
+
+    // Serializes writers only; readers never take it.
+    std::mutex write_mutex_;
+    std::atomic<SnapshotPtr> snapshot_{std::make_shared<const Snapshot>()};
+    std::atomic<uint64_t> version_{0};
     uint32_t next_room_id_ = 1001;
 };
 
@@ -0,0 +1,196 @@
+// ====================================================================
+// LightVoice: Signaling Handlers
+// src/room/SignalingHandlers.cc
+//
+// Implementation of the control message handlers.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "room/SignalingHandlers.h"
+#include "codec/PacketDispatcher.h"
+#include "codec/ProtobufCodec.h"
+#include "common/Logger.h"
+#include "net/EventLoop.h"
+#include "pool/ThreadPool.h"
+#include "proto/chat.pb.h"
+#include "room/RoomManager.h"
+#include "room/VoiceRoom.h"
+#include <atomic>
+
+namespace lightvoice {
+
+// The codec framing every connection, owned by main()
+extern ProtobufCodec* g_codec;
+
+namespace {
+
+std::atomic<uint32_t> g_nextUserId{1};
+// Builds new rooms, owned by main()
+ThreadPool* g_roomWorkers = nullptr;
+
+void reply(const net::TcpConnectionPtr& conn, const proto::Packet& packet) {
+    if (g_codec) {
+        g_codec->send(conn, packet);
+    }
+}
+
+void fillRoomInfo(const VoiceRoom& room, proto::RoomInfo* info) {
+    const AudioConfig& config = room.audioConfig();
+    info->set_room_id(room.id());
+    info->set_room_name(room.name());
+    info->set_member_count(static_cast<uint32_t>(room.memberCount()));
+    info->set_sample_rate(static_cast<uint32_t>(config.sampleRate));
+    info->set_channels(static_cast<uint32_t>(config.channels));
+    info->set_frame_duration_ms(static_cast<uint32_t>(config.frameDurationMs));
+}
+
+// --- Inline (IO thread) ---
+
+void onHeartbeat(const net::TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp) {
+    reply(conn, packet);
+}
+
+void onListRooms(const net::TcpConnectionPtr& conn, const proto::Packet&, Timestamp) {
+    proto::Packet packet;
+    auto* response = packet.mutable_list_rooms_response();
+    for (const VoiceRoomPtr& room : RoomManager::instance().listRooms()) {
+        fillRoomInfo(*room, response->add_rooms());
+    }
+    reply(conn, packet);
+}
+
+// --- Offloaded (worker pool) ---
+
+void onLogin(const net::TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp) {
+    const std::string& username = packet.login_request().username();
+    if (username.empty()) {
+        proto::Packet failed;
+        failed.mutable_login_response()->set_message("Username must not be empty.");
+        reply(conn, failed);
+        return;
+    }
+
+    // A real server would check credentials here, off the IO thread.
+    auto user = std::make_shared<User>(g_nextUserId.fetch_add(1, std::memory_order_relaxed), username, conn);
+
+    // The context is only touched on the connection's loop. A connection
+    // that dropped meanwhile gets no session: nothing would clear it.
+    conn->getLoop()->runInLoop([conn, user] {
+        if (!conn->connected()) {
+            return;
+        }
+        proto::Packet response;
+        auto* login = response.mutable_login_response();
+        if (sessionUser(conn)) {
+            login->set_message("Already logged in.");
+        } else {
+            conn->setContext(user);
+            login->set_success(true);
+            login->set_message("Welcome, " + user->name() + "!");
+            login->set_user_id(user->id());
+            LOGGER_INFO("User {} ({}) logged in from {}", user->name(), user->id(), conn->name());
+        }
+        reply(conn, response);
+    });
+}
+
+// --- Inline, on the connection's loop: these read or change the session ---
+
+void onCreateRoom(const net::TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp) {
+    const proto::CreateRoomRequest& request = packet.create_room_request();
+    UserPtr user = sessionUser(conn);
+    if (!user || request.room_name().empty()) {
+        proto::Packet response;
+        response.mutable_create_room_response()->set_message(!user ? "Not logged in." : "Room name must not be empty.");
+        reply(conn, response);
+        return;
+    }
+
+    // Building the room (mixer, codec state, registration with the mix
+    // scheduler) happens on a worker; it needs nothing from the session
+    // but the owner.
+    g_roomWorkers->enqueue([conn, user, name = request.room_name(), config = audioConfigFromRequest(request)] {
+        proto::Packet response;
+        auto* created = response.mutable_create_room_response();
+        if (VoiceRoomPtr room = RoomManager::instance().createRoom(name, user, config)) {
+            created->set_success(true);
+            fillRoomInfo(*room, created->mutable_room_info());
+        } else {
+            created->set_message("Unsupported audio settings.");
+        }
+        reply(conn, response);
+    });
+}
+
+void onJoinRoom(const net::TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp) {
+    const proto::JoinRoomRequest& request = packet.join_room_request();
+    proto::Packet response;
+    auto* joined = response.mutable_join_room_response();
+    UserPtr user = sessionUser(conn);
+    VoiceRoomPtr room = user ? RoomManager::instance().findRoom(request.room_id()) : nullptr;
+    if (!user) {
+        joined->set_message("Not logged in.");
+    } else if (!room) {
+        joined->set_message("No such room.");
+    } else {
+        if (VoiceRoomPtr current = user->room()) {
+            current->removeUser(user);
+        }
+        room->addUser(user, bundleFramesFromRequest(request));
+        joined->set_success(true);
+        fillRoomInfo(*room, joined->mutable_room_info());
+    }
+    reply(conn, response);
+}
+
+void onLeaveRoom(const net::TcpConnectionPtr& conn, const proto::Packet&, Timestamp) {
+    proto::Packet response;
+    auto* left = response.mutable_leave_room_response();
+    UserPtr user = sessionUser(conn);
+    VoiceRoomPtr room = user ? user->room() : nullptr;
+    if (room) {
+        room->removeUser(user);
+        left->set_success(true);
+    } else {
+        left->set_message("Not in a room.");
+    }
+    reply(conn, response);
+}
+
+void onSendText(const net::TcpConnectionPtr& conn, const proto::Packet& packet, Timestamp receiveTime) {
+    UserPtr user = sessionUser(conn);
+    VoiceRoomPtr room = user ? user->room() : nullptr;
+    if (!room) {
+        return;
+    }
+    proto::Packet notification;
+    auto* text = notification.mutable_text_notification();
+    text->set_sender_id(user->id());
+    text->set_sender_username(user->name());
+    text->set_text(packet.send_text_request().text());
+    text->set_timestamp(static_cast<uint64_t>(receiveTime.microSecondsSinceEpoch() / 1000));
+    room->broadcastMessage(notification);
+}
+
+} // namespace
+
+UserPtr sessionUser(const net::TcpConnectionPtr& conn) {
+    const UserPtr* user = std::any_cast<UserPtr>(&conn->getContext());
+    return user ? *user : nullptr;
+}
+
+void registerSignalingHandlers(PacketDispatcher& dispatcher, ThreadPool* workers) {
+    g_roomWorkers = workers;
+
+    dispatcher.registerInline(proto::Packet::kHeartbeat, onHeartbeat);
+    dispatcher.registerInline(proto::Packet::kListRoomsRequest, onListRooms);
+    dispatcher.registerInline(proto::Packet::kCreateRoomRequest, onCreateRoom);
+    dispatcher.registerInline(proto::Packet::kJoinRoomRequest, onJoinRoom);
+    dispatcher.registerInline(proto::Packet::kLeaveRoomRequest, onLeaveRoom);
+    dispatcher.registerInline(proto::Packet::kSendTextRequest, onSendText);
+
+    dispatcher.registerOffloaded(proto::Packet::kLoginRequest, onLogin);
+}
+
+} // namespace lightvoice
@@ -0,0 +1,37 @@
+// ====================================================================
+// LightVoice: Signaling Handlers
+// src/room/SignalingHandlers.h
+//
+// The server's handlers for every control message: login, heartbeat,
+// creating, listing, joining and leaving rooms, and text chat. They
+// are registered with the PacketDispatcher.
+//
+// A connection's session (the User in its context, and that User's
+// room) is only read or changed on the connection's own loop. Handlers
+// that touch it therefore run inline, which also serializes them per
+// connection and with the disconnect in onConnection(). Work that does
+// not belong on an IO thread goes to the worker pool with what it needs
+// copied out of the session: login's credential check, and building a
+// new room.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "net/TcpConnection.h"
+#include "room/User.h"
+
+namespace lightvoice {
+
+class PacketDispatcher;
+class ThreadPool;
+
+// `workers` builds new rooms and must outlive the dispatcher.
+void registerSignalingHandlers(PacketDispatcher& dispatcher, ThreadPool* workers);
+
+// The User logged in on `conn`, or nullptr before login. Call it on the
+// connection's loop only.
+UserPtr sessionUser(const net::TcpConnectionPtr& conn);
+
+} // namespace lightvoice
@@ -0,0 +1,196 @@
+// ====================================================================
+// LightVoice: Speaker Table
+// src/room/SpeakerTable.cc
+//
+// Implementation of the SpeakerTable class.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "room/SpeakerTable.h"
+#include "codec/OpusDecoder.h"
+#include "common/Logger.h"
+#include <bit>
+#include <stdexcept>
+#include <thread>
+
+namespace lightvoice {
+
+SpeakerTable::SpeakerTable(const AudioConfig& config)
+    : config_(config),
+      frame_size_(config.frameSize()),
+      release_ticks_(static_cast<uint32_t>(kReleaseMs / config.frameDurationMs)) {}
+
+SpeakerTable::~SpeakerTable() = default;
+
+bool SpeakerTable::push(uint32_t speakerId, const MediaFramePtr& frame) {
+    // DTX packets carry no audio; they must not take a slot from someone.
+    if (frame->size() <= AudioMixer::kDtxPacketBytes || speakerId == kFree || speakerId == kReleasing) {
+        return false;
+    }
+    int index = find(speakerId);
+    if (index < 0) {
+        index = claim(speakerId);
+    }
+    if (index < 0) {
+        unslotted_drops_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Announce the write before checking ownership: a release either
+    // sees the writer and waits, or this check sees the release.
+    Slot& slot = slots_[index];
+    slot.writers.fetch_add(1, std::memory_order_seq_cst);
+    const bool pushed = owners_[index].load(std::memory_order_seq_cst) == speakerId && enqueue(slot, frame);
+    slot.writers.fetch_sub(1, std::memory_order_release);
+    return pushed;
+}
+
+int SpeakerTable::find(uint32_t speakerId) const {
+    for (size_t i = 0; i < kSlots; ++i) {
+        if (owners_[i].load(std::memory_order_acquire) == speakerId) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int SpeakerTable::claim(uint32_t speakerId) {
+    for (size_t i = 0; i < kSlots; ++i) {
+        uint32_t expected = kFree;
+        if (owners_[i].load(std::memory_order_relaxed) != kFree ||
+            !owners_[i].compare_exchange_strong(expected, speakerId, std::memory_order_acq_rel)) {
+            continue;
+        }
+
+        // Claimed but not yet active: nobody else touches the slot.
+        Slot& slot = slots_[i];
+        try {
+            if (config_.decodeOnIngress) {
+                if (slot.ingress) {
+                    slot.ingress->reset(speakerId);
+                } else {
+                    slot.ingress = std::make_unique<IngressDecoder>(speakerId, config_.sampleRate, config_.channels,
+                                                                    frame_size_);
+                }
+            } else if (!slot.packets) {
+                slot.packets = std::make_unique<SpscRing<MediaFramePtr>>(IngressDecoder::kRingFrames);
+                slot.decoder = std::make_unique<OpusDecoder>(config_.sampleRate, config_.channels);
+                slot.pcm.assign(static_cast<size_t>(frame_size_) * config_.channels, 0);
+            }
+        } catch (const std::runtime_error& e) {
+            LOGGER_ERROR("SpeakerTable: cannot set up slot {} for speaker {}: {}", i, speakerId, e.what());
+            owners_[i].store(kFree, std::memory_order_release);
+            return -1;
+        }
+        active_.fetch_or(static_cast<uint16_t>(1u << i), std::memory_order_release);
+        LOGGER_DEBUG("SpeakerTable: speaker {} took slot {}", speakerId, i);
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool SpeakerTable::enqueue(Slot& slot, const MediaFramePtr& frame) {
+    if (slot.ingress) {
+        return slot.ingress->decode(frame);
+    }
+    if (!slot.packets->push(frame)) {
+        slot.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void SpeakerTable::collect(std::vector<AudioMixer::PcmSource>& sources) {
+    for (uint32_t mask = activeMask(); mask != 0; mask &= mask - 1) {
+        const size_t index = static_cast<size_t>(std::countr_zero(mask));
+        const uint32_t speakerId = owners_[index].load(std::memory_order_relaxed);
+        const MediaFrame* packet = nullptr;
+        if (const int16_t* pcm = next(slots_[index], speakerId, &packet)) {
+            sources.push_back({speakerId, pcm, packet});
+        }
+    }
+}
+
+const int16_t* SpeakerTable::next(Slot& slot, uint32_t speakerId, const MediaFrame** packet) {
+    const uint64_t dropped = slot.ingress ? slot.ingress->dropped() : slot.dropped.load(std::memory_order_relaxed);
+    if (dropped != slot.reportedDrops) {
+        LOGGER_DEBUG("SpeakerTable: speaker {} dropped {} packets", speakerId, dropped - slot.reportedDrops);
+        slot.reportedDrops = dropped;
+    }
+
+    if (slot.ingress) {
+        const IngressDecoder::PcmFrame* frame = slot.ingress->front();
+        if (!frame) {
+            return nullptr;
+        }
+        slot.collected = true;
+        *packet = frame->packet.get();
+        return frame->pcm.data();
+    }
+
+    // A backlog means the speaker sent a burst; the oldest packets are
+    // skipped rather than delay their voice for good.
+    SpscRing<MediaFramePtr>& packets = *slot.packets;
+    while (packets.size() > IngressDecoder::kMaxBufferedFrames) {
+        packets.front()->reset();
+        packets.pop();
+        slot.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    MediaFramePtr* front = packets.front();
+    if (!front) {
+        return nullptr;
+    }
+    slot.current = std::move(*front);
+    packets.pop();
+    slot.collected = true;
+    const int decoded = slot.decoder->decode(slot.current->data(), slot.current->size(), slot.pcm.data(), frame_size_);
+    if (decoded != frame_size_) {
+        return nullptr;
+    }
+    *packet = slot.current.get();
+    return slot.pcm.data();
+}
+
+void SpeakerTable::advance() {
+    for (uint32_t mask = activeMask(); mask != 0; mask &= mask - 1) {
+        const size_t index = static_cast<size_t>(std::countr_zero(mask));
+        Slot& slot = slots_[index];
+        if (slot.collected) {
+            if (slot.ingress) {
+                slot.ingress->pop();
+            } else {
+                slot.current.reset();
+            }
+            slot.collected = false;
+            slot.idleTicks = 0;
+        } else if (++slot.idleTicks >= release_ticks_) {
+            release(index);
+        }
+    }
+}
+
+void SpeakerTable::release(size_t index) {
+    Slot& slot = slots_[index];
+    const uint32_t speakerId = owners_[index].exchange(kReleasing, std::memory_order_seq_cst);
+    active_.fetch_and(static_cast<uint16_t>(~(1u << index)), std::memory_order_acq_rel);
+
+    // A producer that saw the old owner is at most one enqueue away.
+    while (slot.writers.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+    if (slot.ingress) {
+        slot.ingress->reset(kFree);
+    } else {
+        while (MediaFramePtr* packet = slot.packets->front()) {
+            packet->reset();
+            slot.packets->pop();
+        }
+        slot.decoder->reset();
+    }
+    slot.idleTicks = 0;
+    LOGGER_DEBUG("SpeakerTable: speaker {} gave up slot {}", speakerId, index);
+    owners_[index].store(kFree, std::memory_order_release);
+}
+
+} // namespace lightvoice
@@ -0,0 +1,133 @@
+// ====================================================================
+// LightVoice: Speaker Table
+// src/room/SpeakerTable.h
+//
+// A room's fixed table of kSlots speaker slots. Each slot holds what
+// one speaker's audio needs on its way to the mixer: their Opus
+// decoder, the jitter state (a small ring of packets, or of frames
+// decoded on ingress) and the PCM buffer the mixer reads. Slots are
+// cache-line aligned, allocated once and reused, and a 16-bit atomic
+// mask records which are active, so a tick visits only the set bits.
+//
+// A room can have more members than slots. A member gets a slot with
+// their first audible packet, if one is free; packets that find none
+// are dropped and counted. The mixer thread gives a slot up once no
+// audio has come from its speaker for kReleaseMs, so the next member
+// to speak can take it over. Members that leave are released the same
+// way. The VAD has no say: an open microphone it gates keeps sending,
+// and releasing it would only have it take a slot back a packet later.
+//
+// Each slot has one producer at a time, the IO loop of the speaker
+// owning it, and one consumer, the mixer thread. A producer announces
+// itself in the slot's writer count before it checks the slot is still
+// its own, and a release waits for that count to drain, so a slot never
+// has two producers even while it changes hands. Neither side takes a
+// lock.
+//
+// Author: Gemini
+// ====================================================================
+
+#pragma once
+
+#include "common/noncopyable.h"
+#include "codec/AudioConfig.h"
+#include "codec/AudioMixer.h"
+#include "codec/IngressDecoder.h"
+#include "codec/MediaFrame.h"
+#include "pool/SpscRing.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lightvoice {
+
+class OpusDecoder;
+
+class SpeakerTable : noncopyable {
+public:
+    // Simultaneous speakers a room mixes; one bit each in the mask.
+    static constexpr size_t kSlots = AudioMixer::kDefaultSourceSlots;
+    static_assert(kSlots <= 16, "the active mask is 16 bits wide");
+    // A slot is given up after no audio came from its speaker this long.
+    static constexpr int kReleaseMs = 1000;
+
+    explicit SpeakerTable(const AudioConfig& config);
+    ~SpeakerTable();
+
+    // --- IO thread of the speaker's connection ---
+
+    // Hands one packet to the speaker's slot, taking a free slot if they
+    // have none; decodes it right away when the room decodes on ingress.
+    // Returns false if the packet was dropped: DTX (no audio), no free
+    // slot, a full ring, or undecodable.
+    bool push(uint32_t speakerId, const MediaFramePtr& frame);
+
+    // --- Mixer thread ---
+
+    // Appends the next frame of every active speaker to `sources`, in
+    // slot order. The PCM and packets stay valid until advance().
+    void collect(std::vector<AudioMixer::PcmSource>& sources);
+
+    // Releases the frames handed out by collect() and gives up the slots
+    // of speakers who sent no audio for kReleaseMs.
+    void advance();
+
+    // --- Any thread (a snapshot) ---
+
+    uint16_t activeMask() const { return active_.load(std::memory_order_acquire); }
+    // Packets dropped because every slot was taken.
+    uint64_t unslottedDrops() const { return unslotted_drops_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t kFree = 0;
+    static constexpr uint32_t kReleasing = UINT32_MAX;
+
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> writers{0}; // Producers inside push()
+        // Packets lost to a full ring or skipped to bound latency
+        // (decoding on ingress, the IngressDecoder counts them).
+        std::atomic<uint64_t> dropped{0};
+
+        // Created by the first speaker to take the slot, then reused.
+        // Decoding on ingress, the IngressDecoder holds the decoder and
+        // the PCM ring; otherwise the packets wait in `packets` and the
+        // mixer decodes them into `pcm`.
+        std::unique_ptr<IngressDecoder> ingress;
+        std::unique_ptr<SpscRing<MediaFramePtr>> packets;
+        std::unique_ptr<OpusDecoder> decoder;
+        std::vector<int16_t> pcm;
+
+        // Mixer-thread only.
+        MediaFramePtr current;          // The packet pcm was decoded from
+        bool collected = false;         // collect() took a packet this tick
+        uint32_t idleTicks = 0;         // Ticks in a row with no packet
+        uint64_t reportedDrops = 0;
+    };
+
+    // The speaker's slot, or -1.
+    int find(uint32_t speakerId) const;
+    // Takes a free slot for the speaker, or returns -1.
+    int claim(uint32_t speakerId);
+    // Mixer thread: empties the slot and marks it free.
+    void release(size_t index);
+
+    static bool enqueue(Slot& slot, const MediaFramePtr& frame);
+    // Mixer thread: the slot's next decoded frame, or nullptr.
+    const int16_t* next(Slot& slot, uint32_t speakerId, const MediaFrame** packet);
+
+    const AudioConfig config_;
+    const int frame_size_;
+    const uint32_t release_ticks_;
+
+    // The speaker in each slot (kFree, or kReleasing while it is being
+    // emptied), packed in one cache line for the IO threads' lookup.
+    alignas(64) std::array<std::atomic<uint32_t>, kSlots> owners_{};
+    std::atomic<uint16_t> active_{0};
+    std::atomic<uint64_t> unslotted_drops_{0};
+
+    std::array<Slot, kSlots> slots_;
+};
+
+} // namespace lightvoice
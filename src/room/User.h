@@ -3,7 +3,12 @@
 // src/room/User.h
 //
 // Represents a connected user. Holds user information and a pointer
-// to their TCP connection.
+// to their TCP connection, and which bitrate tier of their room's mix
+// they currently receive.
+//
+// The connection owns its User (in its context), so the User only
+// refers back to it weakly; a room that outlives its owner's
+// connection does not keep the connection alive either.
 //
 // Author: Gemini
 // ====================================================================
@@ -11,6 +16,7 @@
 #pragma once
 
 #include "net/TcpConnection.h"
+#include "room/BitrateTierSelector.h"
 #include <string>
 #include <memory>
 
@@ -26,17 +32,26 @@ public:
 
     uint32_t id() const { return id_; }
     const std::string& name() const { return name_; }
-    net::TcpConnectionPtr conn() const { return conn_; }
+    // nullptr once the connection is gone.
+    net::TcpConnectionPtr conn() const { return conn_.lock(); }
     
+    // Only on the connection's loop, which serializes joins, leaves,
+    // the disconnect and every voice packet of the session.
     void setRoom(VoiceRoomPtr room) { room_ = room; }
     void clearRoom() { room_.reset(); }
     VoiceRoomPtr room() const { return room_.lock(); }
 
+    // Mixer-thread only: the room re-evaluates it from the connection's
+    // send-queue drain rate.
+    BitrateTierSelector& tierSelector() { return tierSelector_; }
+    int bitrateTier() const { return tierSelector_.tier(); }
+
 private:
     uint32_t id_;
     std::string name_;
-    net::TcpConnectionPtr conn_;
+    std::weak_ptr<net::TcpConnection> conn_;
     std::weak_ptr<VoiceRoom> room_;
+    BitrateTierSelector tierSelector_;
 };
 
 using UserPtr = std::shared_ptr<User>;
@@ -9,50 +9,109 @@
 
 #include "room/VoiceRoom.h"
 #include "room/User.h" // Assuming User class exists
+#include "net/EventLoop.h"
 #include "net/TcpConnection.h"
 #include "common/Logger.h"
 #include "proto/chat.pb.h"
 #include "codec/ProtobufCodec.h" // Assuming this exists
+#include "pool/ThreadPool.h"
+#include "timer/MixScheduler.h"
+#include <algorithm>
 
 namespace lightvoice {
 
-// Assume a global ProtobufCodec instance for sending messages
+// The codec framing every connection, owned by main()
 extern ProtobufCodec* g_codec;
+// The mixer thread's scheduler, owned by main()
+extern MixScheduler* g_mixScheduler;
+// Worker pool for forked tier encodes, owned by main()
+extern ThreadPool* g_encodePool;
 
-VoiceRoom::VoiceRoom(uint32_t id, std::string name, UserPtr owner)
+VoiceRoom::VoiceRoom(uint32_t id, std::string name, UserPtr owner, const AudioConfig& config)
     : id_(id),
       name_(std::move(name)),
       owner_(owner),
-      mixer_(std::make_unique<AudioMixer>(48000, 1, 960)) {
-    LOGGER_INFO("VoiceRoom created: {} ({})", name_, id_);
+      config_(config),
+      mixer_(std::make_unique<AudioMixer>(config.sampleRate, config.channels, config.frameSize())),
+      speakers_(config) {
+    mixer_->setEncodePool(g_encodePool);
+    mixer_->setPassThrough(config.passThrough);
+    LOGGER_INFO("VoiceRoom created: {} ({}), {}Hz {}ch {}ms", name_, id_,
+                config_.sampleRate, config_.channels, config_.frameDurationMs);
 }
 
 VoiceRoom::~VoiceRoom() {
-    LOGGER_INFO("VoiceRoom destroyed: {} ({})", name_, id_);
+    // Nothing can be mixing any more: a tick holds a reference to the room.
+    const AudioMixer::Stats& stats = mixer_->stats();
+    LOGGER_INFO("VoiceRoom destroyed: {} ({}), skipped {}/{} encodes ({:.1f}%), {} packets found no speaker slot",
+                name_, id_, stats.skippedEncodes, stats.ticks, 100.0 * stats.skippedRatio(),
+                speakers_.unslottedDrops());
+    // A batch an IO loop has not written yet is freed by that loop.
+    for (LoopDeliveries& entry : deliveries_) {
+        for (ProtobufCodec::MediaBatch* batch : entry.batches) {
+            ProtobufCodec::MediaBatch::dispose(batch);
+        }
+    }
 }
 
 void VoiceRoom::start() {
-    // This is where we would start the 20ms mix timer
-    // For simplicity, we'll simulate it. In a real app, this would be
-    // driven by the TimerManager in the Mixer thread.
+    if (!g_mixScheduler) {
+        LOGGER_WARN("VoiceRoom {}: no mix scheduler, room will not be mixed", id_);
+        return;
+    }
+    // The scheduler must not keep the room alive after it is destroyed.
+    std::weak_ptr<VoiceRoom> weakRoom = shared_from_this();
+    g_mixScheduler->addRoom(id_, config_.frameDurationMs, [weakRoom] {
+        if (auto room = weakRoom.lock()) {
+            room->onMixTimer();
+        }
+    });
 }
 
 void VoiceRoom::stop() {
-    // Stop the mix timer
+    if (g_mixScheduler) {
+        g_mixScheduler->removeRoom(id_);
+    }
 }
 
-void VoiceRoom::addUser(UserPtr user) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    members_[user->id()] = user;
-    user->setRoom(shared_from_this());
+namespace {
+
+template <typename Members>
+auto findMember(Members& members, uint32_t id) {
+    return std::lower_bound(members.begin(), members.end(), id,
+                            [](const auto& member, uint32_t key) { return member.id < key; });
+}
+
+} // namespace
+
+void VoiceRoom::addUser(UserPtr user, int bundleFrames) {
+    net::TcpConnectionPtr conn = user->conn();
+    Member member{user->id(), user, conn, conn ? conn->getLoop() : nullptr,
+                  bundleFrames > 1 ? std::make_shared<FrameBundler>(bundleFrames, config_.sampleRate) : nullptr};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        MemberList members = *members_.load(std::memory_order_acquire);
+        auto it = findMember(members, member.id);
+        if (member.loop) {
+            claimMemberLoop(member.loop);
+        }
+        if (it != members.end() && it->id == member.id) {
+            *it = std::move(member);
+        } else {
+            members.insert(it, std::move(member));
+        }
+        publishMembers(std::move(members));
+        user->setRoom(shared_from_this());
+    }
 
     // Notify others
-    proto::RoomNotification notif;
-    notif.set_type(proto::RoomNotification::JOIN);
-    notif.set_user_id(user->id());
-    notif.set_username(user->name());
-    notif.set_message(user->name() + " has joined the room.");
-    broadcastMessage(notif);
+    proto::Packet packet;
+    auto* notif = packet.mutable_room_notification();
+    notif->set_type(proto::RoomNotification::JOIN);
+    notif->set_user_id(user->id());
+    notif->set_username(user->name());
+    notif->set_message(user->name() + " has joined the room.");
+    broadcastMessage(packet);
 
     LOGGER_INFO("User {} joined room {}", user->name(), name_);
 }
@@ -60,62 +119,264 @@ void VoiceRoom::addUser(UserPtr user) {
 void VoiceRoom::removeUser(UserPtr user) {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        members_.erase(user->id());
+        MemberList members = *members_.load(std::memory_order_acquire);
+        auto it = findMember(members, user->id());
+        if (it != members.end() && it->id == user->id()) {
+            members.erase(it);
+            publishMembers(std::move(members));
+        }
+        pending_updates_.push_back({SpeakerUpdate::kLeft, user->id(), 1.0f});
         user->clearRoom();
     }
     
     // Notify others
-    proto::RoomNotification notif;
-    notif.set_type(proto::RoomNotification::LEAVE);
-    notif.set_user_id(user->id());
-    notif.set_username(user->name());
-    notif.set_message(user->name() + " has left the room.");
-    broadcastMessage(notif);
+    proto::Packet packet;
+    auto* notif = packet.mutable_room_notification();
+    notif->set_type(proto::RoomNotification::LEAVE);
+    notif->set_user_id(user->id());
+    notif->set_username(user->name());
+    notif->set_message(user->name() + " has left the room.");
+    broadcastMessage(packet);
     
     LOGGER_INFO("User {} left room {}", user->name(), name_);
 }
 
-void VoiceRoom::onAudioPacket(uint32_t userId, AudioFramePtr frame) {
-    // This function would be called by the IO thread.
-    // It should push the frame to a lock-free queue for the mixer thread.
-    std::lock_guard<std::mutex> lock(mutex_);
-    pending_frames_.push_back(frame);
+void VoiceRoom::publishMembers(MemberList members) {
+    // The snapshot goes out before its version, so a loop that sees the
+    // new version also loads the new snapshot.
+    members_.store(std::make_shared<const MemberList>(std::move(members)), std::memory_order_release);
+    members_version_.fetch_add(1, std::memory_order_release);
+}
+
+void VoiceRoom::claimMemberLoop(net::EventLoop* loop) {
+    for (LoopMembers& slot : loop_members_) {
+        net::EventLoop* owner = slot.loop.load(std::memory_order_relaxed);
+        if (owner == loop) {
+            return;
+        }
+        if (!owner) {
+            slot.loop.store(loop, std::memory_order_release);
+            return;
+        }
+    }
+    LOGGER_WARN("VoiceRoom {}: more than {} IO loops, audio from the rest checks the shared member list", id_,
+                kMaxMemberLoops);
+}
+
+bool VoiceRoom::isMember(uint32_t userId) {
+    for (LoopMembers& slot : loop_members_) {
+        net::EventLoop* loop = slot.loop.load(std::memory_order_acquire);
+        if (!loop) {
+            break;
+        }
+        if (!loop->isInLoopThread()) {
+            continue;
+        }
+        const uint64_t version = members_version_.load(std::memory_order_acquire);
+        if (slot.version != version) {
+            // Only a join or leave costs this loop a snapshot load.
+            const MemberSnapshot members = members_.load(std::memory_order_acquire);
+            slot.ids.clear();
+            for (const Member& member : *members) {
+                slot.ids.push_back(member.id);
+            }
+            slot.version = version;
+        }
+        return std::binary_search(slot.ids.begin(), slot.ids.end(), userId);
+    }
+    const MemberSnapshot members = members_.load(std::memory_order_acquire);
+    auto it = findMember(*members, userId);
+    return it != members->end() && it->id == userId;
+}
+
+void VoiceRoom::onAudioPacket(uint32_t userId, MediaFramePtr frame) {
+    // This function would be called by the IO thread. Only members get a
+    // speaker slot.
+    frame->header().speakerId = userId;
+    if (!isMember(userId)) {
+        return;
+    }
+    speakers_.push(userId, frame);
 }
 
 void VoiceRoom::onMixTimer() {
-    // This function is called by the Mixer thread every 20ms.
-    std::vector<AudioFramePtr> frames_to_mix;
+    // This function is called by the MixScheduler on the mixer thread once
+    // per frame duration (20ms by default).
+    // Silent ticks still go through the mixer, which decides whether a
+    // comfort-noise frame is due; only an empty room is skipped.
+    const MemberSnapshot members = members_.load(std::memory_order_acquire);
+    if (members->empty()) {
+        return;
+    }
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (pending_frames_.empty()) {
-            return;
+        mixing_updates_.swap(pending_updates_);
+    }
+
+    for (const SpeakerUpdate& update : mixing_updates_) {
+        if (update.kind == SpeakerUpdate::kLeft) {
+            mixer_->removeSpeaker(update.userId);
+        } else {
+            mixer_->setSpeakerGain(update.userId, update.gain);
         }
-        frames_to_mix.swap(pending_frames_);
     }
+    mixing_updates_.clear();
 
-    AudioFramePtr mixed_frame = mixer_->mix(frames_to_mix);
-    if (!mixed_frame) {
-        return;
+    // Take one decoded frame per active speaker slot, in the order each
+    // speaker sent them; the slots are released for the next tick once
+    // the mix is encoded.
+    speakers_.collect(mixing_sources_);
+    AudioMixer::TierFrames mixed;
+    const size_t tiers_mixed = mixer_->mixDecoded(mixing_sources_, tier_mask_, mixed);
+    const size_t frames_mixed = mixing_sources_.size();
+    speakers_.advance();
+    mixing_sources_.clear();
+
+    // A lone speaker's own voice is not sent back to them, on any tier.
+    const uint32_t sole_speaker = mixer_->soleSpeaker();
+
+    std::array<uint32_t, kMaxDominantSpeakers> dominant;
+    const size_t num_dominant = mixer_->dominantSpeakers(dominant.data(), dominant.size());
+
+    const int evaluation_ticks = kTierEvaluationMs / config_.frameDurationMs;
+    const bool evaluate_tiers = ++ticks_since_tier_evaluation_ >= evaluation_ticks;
+    if (evaluate_tiers) {
+        ticks_since_tier_evaluation_ = 0;
+    }
+    int32_t tier_bitrates[AudioMixer::kMaxTiers];
+    for (int t = 0; t < AudioMixer::kMaxTiers; ++t) {
+        tier_bitrates[t] = mixer_->tierBitrate(t);
     }
 
-    // Broadcast mixed audio to all members
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (const auto& pair : members_) {
-        // This is a simplification. In reality, you'd have a custom voice protocol.
-        // You would not use the protobuf codec for high-frequency voice data.
-        // We'll just log it for now.
-        // pair.second->conn()->send(*mixed_frame);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dominant_speakers_ = dominant;
+        num_dominant_speakers_ = num_dominant;
+    }
+
+    // Broadcast mixed audio to all members, each in their tier. Tiers are
+    // re-evaluated from every listener's send-queue drain rate, and the
+    // next tick encodes only the tiers someone is in. The snapshot is
+    // walked without the room lock.
+    uint32_t tier_mask = 0;
+    for (const Member& member : *members) {
+        User& user = *member.user;
+        const net::TcpConnectionPtr& conn = member.conn;
+        if (evaluate_tiers && conn) {
+            user.tierSelector().update(conn->outputBacklog(), conn->bytesSent(),
+                                       int64_t(evaluation_ticks) * config_.frameDurationMs * 1000,
+                                       tier_bitrates, AudioMixer::kMaxTiers);
+        }
+        const int tier = user.bitrateTier();
+        tier_mask |= 1u << tier;
+        FrameBundler* bundler = member.bundler.get();
+        if (tiers_mixed == 0) {
+            // Nothing new this tick: release any bundled frames still held
+            // back rather than delay them across the silence.
+            if (bundler && bundler->pending() > 0) {
+                MediaFramePtr bundle = bundler->flush();
+                if (bundle && conn) {
+                    queueDelivery(member.loop, conn, bundle);
+                }
+            }
+            continue;
+        }
+
+        // A listener who just changed tier gets the closest tier that was
+        // encoded this tick, preferring the lighter ones.
+        const MediaFramePtr* frame = &mixed[tier];
+        for (int t = tier; !*frame && t < AudioMixer::kMaxTiers; ++t) {
+            frame = &mixed[t];
+        }
+        for (int t = tier; !*frame && t >= 0; --t) {
+            frame = &mixed[t];
+        }
+        if (member.id == sole_speaker) {
+            continue;
+        }
+
+        // Listeners that opted into bundling get one packet every few ticks.
+        const MediaFramePtr& packet = bundler ? bundler->push(*frame) : *frame;
+
+        // Binary media framing, not protobuf. Every member of a tier shares
+        // the same pooled frame; a reference travels with each delivery.
+        if (packet && conn) {
+            queueDelivery(member.loop, conn, packet);
+        }
+    }
+    tier_mask_ = tier_mask ? tier_mask : 1u;
+    flushDeliveries();
+
+    if (tiers_mixed > 0) {
+        LOGGER_TRACE("Mixed {} frames into {} tiers for {} members", frames_mixed, tiers_mixed, members->size());
     }
-    LOGGER_TRACE("Mixed {} frames, sent {} bytes to {} members", frames_to_mix.size(), mixed_frame->size(), members_.size());
 }
 
-void VoiceRoom::broadcastMessage(const google::protobuf::Message& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for(const auto& pair : members_) {
+void VoiceRoom::queueDelivery(net::EventLoop* loop, const net::TcpConnectionPtr& conn, const MediaFramePtr& frame) {
+    // A server has a handful of IO loops, so a linear scan finds the batch.
+    auto it = std::find_if(deliveries_.begin(), deliveries_.end(),
+                           [loop](const LoopDeliveries& entry) { return entry.loop == loop; });
+    if (it == deliveries_.end()) {
+        it = deliveries_.insert(deliveries_.end(), LoopDeliveries{loop, nullptr, {}});
+    }
+    if (!it->filling) {
+        for (ProtobufCodec::MediaBatch* batch : it->batches) {
+            if (!batch->inFlight()) {
+                it->filling = batch;
+                break;
+            }
+        }
+        if (!it->filling) {
+            it->filling = it->batches.emplace_back(new ProtobufCodec::MediaBatch());
+        }
+    }
+    it->filling->deliveries.push_back({conn, frame});
+}
+
+void VoiceRoom::flushDeliveries() {
+    for (LoopDeliveries& entry : deliveries_) {
+        ProtobufCodec::MediaBatch* batch = std::exchange(entry.filling, nullptr);
+        if (!batch) {
+            continue;
+        }
         if (g_codec) {
-            // g_codec->send(pair.second->conn(), message);
+            // The loop empties the batch and hands it back for reuse.
+            g_codec->sendMediaBatch(entry.loop, batch);
+        } else {
+            batch->deliveries.clear();
+        }
+    }
+}
+
+void VoiceRoom::setSpeakerGain(uint32_t userId, float gain) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_updates_.push_back({SpeakerUpdate::kGain, userId, gain});
+}
+
+size_t VoiceRoom::memberCount() const {
+    return members_.load(std::memory_order_acquire)->size();
+}
+
+std::vector<uint32_t> VoiceRoom::dominantSpeakers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<uint32_t>(dominant_speakers_.begin(), dominant_speakers_.begin() + num_dominant_speakers_);
+}
+
+void VoiceRoom::broadcastMessage(const proto::Packet& packet) {
+    if (!g_codec) {
+        return;
+    }
+    // The codec frames the message once for every receiver in the
+    // current member snapshot; the room lock is never taken.
+    const MemberSnapshot members = members_.load(std::memory_order_acquire);
+    std::vector<net::TcpConnectionPtr> conns;
+    conns.reserve(members->size());
+    for (const Member& member : *members) {
+        if (member.conn) {
+            conns.push_back(member.conn);
         }
     }
+    g_codec->broadcast(conns, packet);
 }
 
 
@@ -5,56 +5,190 @@
 // Represents a single voice chat room. It manages members, handles
 // audio packet routing, and owns the AudioMixer for the room.
 //
+// The member list is an immutable snapshot, a flat vector sorted by id
+// with each member's connection and IO loop cached, swapped atomically
+// when someone joins or leaves. The mix tick and broadcasts read it
+// without taking the room lock, so IO threads pushing audio never wait
+// behind a fan-out. (std::atomic<std::shared_ptr> is not lock-free in
+// libstdc++: a load or store spins on a lock bit in the control pointer,
+// held only for the reference count update.)
+//
+// Incoming audio does not load that snapshot. As in the RoomManager,
+// every change bumps a version, and each IO loop with members in the
+// room keeps its own copy of the member ids, refreshed only when the
+// version has moved on; a packet's membership check is an acquire load
+// of the version and a search of the loop's copy. The audio then goes
+// into the room's SpeakerTable, a fixed set of speaker slots each fed by
+// one IO loop, which the mixer thread drains, one frame per active slot
+// per tick, in arrival order.
+//
+// The mixer's per-speaker state belongs to the mixer thread. Gain
+// changes and departures reach it as SpeakerUpdates, queued under the
+// room lock and applied, in order, at the start of the next tick.
+//
 // Author: Gemini
 // ====================================================================
 
 #pragma once
 
 #include "common/noncopyable.h"
+#include "codec/AudioConfig.h"
 #include "codec/AudioMixer.h"
+#include "codec/FrameBundler.h"
+#include "codec/ProtobufCodec.h"
+#include "room/SpeakerTable.h"
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <string>
-#include <map>
 #include <memory>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace lightvoice {
 
+namespace proto {
+class Packet;
+}
+
 class User; // Forward declaration
 using UserPtr = std::shared_ptr<User>;
 
 class VoiceRoom : noncopyable, public std::enable_shared_from_this<VoiceRoom> {
 public:
-    VoiceRoom(uint32_t id, std::string name, UserPtr owner);
+    // How many of the loudest active speakers the room tracks.
+    static constexpr size_t kMaxDominantSpeakers = 3;
+    // How often listeners' bitrate tiers are re-evaluated.
+    static constexpr int kTierEvaluationMs = 1000;
+
+    VoiceRoom(uint32_t id, std::string name, UserPtr owner, const AudioConfig& config = AudioConfig());
     ~VoiceRoom();
 
     void start();
     void stop();
 
-    void addUser(UserPtr user);
+    // Both on the user's connection loop, which owns their User::room().
+    // bundleFrames > 1 makes the room send this listener that many
+    // consecutive mixed frames per packet (see FrameBundler).
+    void addUser(UserPtr user, int bundleFrames = 1);
     void removeUser(UserPtr user);
     
-    void onAudioPacket(uint32_t userId, AudioFramePtr frame);
+    // IO thread of the user's connection. Takes no lock and writes no
+    // shared memory outside the speaker's slot (see above); the packet is
+    // dropped (and counted) if no speaker slot or ring space is free.
+    void onAudioPacket(uint32_t userId, MediaFramePtr frame);
     
-    void broadcastMessage(const google::protobuf::Message& message);
+    // Sends `packet` to every member. It is serialized once, outside the
+    // room lock, and queued with one task per IO loop. Clients parse every
+    // control frame as a proto::Packet, so nothing else can be broadcast.
+    void broadcastMessage(const proto::Packet& packet);
 
     uint32_t id() const { return id_; }
     const std::string& name() const { return name_; }
+    const AudioConfig& audioConfig() const { return config_; }
+    size_t memberCount() const;
+
+    // Scales a member's voice in the mix (1 = unchanged), from the next
+    // tick on. Callable from any thread.
+    void setSpeakerGain(uint32_t userId, float gain);
+
+    // The currently active speakers as of the last mix tick, loudest first.
+    std::vector<uint32_t> dominantSpeakers() const;
 
 private:
+    struct Member {
+        uint32_t id;
+        UserPtr user;
+        net::TcpConnectionPtr conn; // May be null for a user without a connection
+        net::EventLoop* loop;       // conn's loop, or null
+        // Set when the listener asked for bundled frames. Only the mixer
+        // thread uses it; an older snapshot keeps it alive after leaving.
+        std::shared_ptr<FrameBundler> bundler;
+    };
+    using MemberList = std::vector<Member>; // Sorted by id
+    using MemberSnapshot = std::shared_ptr<const MemberList>;
+
+    // One IO loop's copy of the member ids, for the audio path. The slot
+    // is claimed under mutex_ when the loop's first member joins; after
+    // that only the loop's own thread touches version and ids.
+    struct alignas(64) LoopMembers {
+        std::atomic<net::EventLoop*> loop{nullptr};
+        uint64_t version = 0;
+        std::vector<uint32_t> ids; // Sorted
+    };
+    // IO loops a room keeps a copy for; a server runs a handful. Audio
+    // from any further loop checks the shared snapshot instead.
+    static constexpr size_t kMaxMemberLoops = 16;
+
+    // A change to one speaker's mixer state.
+    struct SpeakerUpdate {
+        enum Kind { kGain, kLeft };
+        Kind kind;
+        uint32_t userId;
+        float gain; // kGain only
+    };
+
     void onMixTimer();
 
+    // Requires mutex_: publishes `members` and bumps members_version_.
+    void publishMembers(MemberList members);
+    // Requires mutex_: gives `loop` a LoopMembers slot if it has none.
+    void claimMemberLoop(net::EventLoop* loop);
+    // IO thread: whether userId is a member, by the calling loop's copy.
+    bool isMember(uint32_t userId);
+
+    // Mixer thread: adds a listener's frame to their IO loop's batch, and
+    // posts every non-empty batch at the end of the tick.
+    void queueDelivery(net::EventLoop* loop, const net::TcpConnectionPtr& conn, const MediaFramePtr& frame);
+    void flushDeliveries();
+
     uint32_t id_;
     std::string name_;
     UserPtr owner_;
+    const AudioConfig config_;
     
-    std::mutex mutex_;
-    std::map<uint32_t, UserPtr> members_;
+    // Serializes membership changes and guards the speaker update and
+    // dominant speaker hand-offs; the audio path does not take it.
+    mutable std::mutex mutex_;
+    // Replaced (under mutex_) on join and leave; read without it.
+    std::atomic<MemberSnapshot> members_{std::make_shared<const MemberList>()};
+    // Bumped after every new snapshot is stored.
+    std::atomic<uint64_t> members_version_{0};
+    std::array<LoopMembers, kMaxMemberLoops> loop_members_;
     
     std::unique_ptr<AudioMixer> mixer_;
     
-    // Frames received in the last 20ms interval, waiting to be mixed.
-    std::vector<AudioFramePtr> pending_frames_;
+    // Fed by the speakers' IO threads, drained by the mixer thread.
+    SpeakerTable speakers_;
+
+    // Mixer-thread only: this tick's decoded frames, one per active
+    // speaker, refilled every tick without reallocating.
+    std::vector<AudioMixer::PcmSource> mixing_sources_;
+
+    // Speaker updates waiting for the mixer thread, and its swap partner.
+    std::vector<SpeakerUpdate> pending_updates_;
+    std::vector<SpeakerUpdate> mixing_updates_;
+
+    // Mixer-thread only: tiers with at least one listener, as of the
+    // previous tick, and ticks since the last tier evaluation.
+    uint32_t tier_mask_ = 1;
+    int ticks_since_tier_evaluation_ = 0;
+
+    // Mixer-thread only: this tick's outgoing frames, one batch per IO
+    // loop, so cross-thread posts scale with loops rather than listeners.
+    // A loop's batches are reused once it has written them: normally one,
+    // a second while the loop is still busy with the previous tick's.
+    struct LoopDeliveries {
+        net::EventLoop* loop;
+        ProtobufCodec::MediaBatch* filling = nullptr; // This tick's batch
+        std::vector<ProtobufCodec::MediaBatch*> batches; // Disposed by ~VoiceRoom
+    };
+    std::vector<LoopDeliveries> deliveries_;
+
+    // Published by the mixer thread under mutex_ after every tick.
+    std::array<uint32_t, kMaxDominantSpeakers> dominant_speakers_{};
+    size_t num_dominant_speakers_ = 0;
 };
 
 using VoiceRoomPtr = std::shared_ptr<VoiceRoom>;
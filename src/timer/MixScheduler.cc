@@ -0,0 +1,231 @@
+// ====================================================================
+// LightVoice: Mix Scheduler
+// src/timer/MixScheduler.cc
+//
+// Implementation for the MixScheduler class. This file contains
+// Linux-specific code using an absolute-time timerfd.
+//
+// Author: Gemini
+// ====================================================================
+
+#include "timer/MixScheduler.h"
+#include "net/EventLoop.h"
+#include "net/Channel.h"
+#include "common/Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <future>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace lightvoice {
+
+namespace {
+
+#ifdef __linux__
+int createMixTimerfd() {
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0) {
+        LOGGER_CRITICAL("Failed to create mix scheduler timerfd");
+    }
+    return timerfd;
+}
+
+int64_t monotonicNowNs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+#else
+int64_t monotonicNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+} // namespace
+
+MixScheduler::MixScheduler(net::EventLoop* loop)
+    : loop_(loop),
+#ifdef __linux__
+      timerfd_(createMixTimerfd()),
+      timerfdChannel_(std::make_unique<net::Channel>(loop, timerfd_)),
+#else
+      timerfd_(0),
+      timerfdChannel_(nullptr),
+#endif
+      epochNs_(monotonicNowNs()) {
+#ifdef __linux__
+    LOGGER_DEBUG("MixScheduler created, timerfd = {}, {} phases of {}us",
+                 timerfd_, kNumPhases, kPhaseStepNs / 1000);
+    timerfdChannel_->setReadCallback(std::bind(&MixScheduler::handleRead, this));
+    // The channel must be registered from the mixer loop's own thread.
+    loop_->runInLoop([this] {
+        timerfdChannel_->enableReading();
+        armTimerfd();
+    });
+#else
+    LOGGER_WARN("MixScheduler is using a dummy implementation on non-Linux systems.");
+#endif
+}
+
+MixScheduler::~MixScheduler() {
+#ifdef __linux__
+    // The reverse of the constructor: the channel is unregistered from the
+    // mixer loop's thread, and the fd closed only once that has happened.
+    auto teardown = [this] {
+        timerfdChannel_->disableAll();
+        timerfdChannel_->remove();
+    };
+    if (loop_->isInLoopThread()) {
+        teardown();
+    } else {
+        std::promise<void> done;
+        std::future<void> removed = done.get_future();
+        loop_->runInLoop([&teardown, &done] {
+            teardown();
+            done.set_value();
+        });
+        removed.wait();
+    }
+    ::close(timerfd_);
+#endif
+}
+
+void MixScheduler::addRoom(uint32_t roomId, int periodMs, TimerCallback cb) {
+    if (!isSupportedPeriod(periodMs)) {
+        LOGGER_ERROR("MixScheduler: room {} asked for an unsupported {}ms period", roomId, periodMs);
+        return;
+    }
+    loop_->runInLoop([this, roomId, periodSteps = periodMs / kStepMs, cb = std::move(cb)]() mutable {
+        addRoomInLoop(roomId, periodSteps, std::move(cb));
+    });
+}
+
+void MixScheduler::removeRoom(uint32_t roomId) {
+    // Always deferred, so a room may unregister from inside its own tick.
+    loop_->queueInLoop(std::bind(&MixScheduler::removeRoomInLoop, this, roomId));
+}
+
+MixScheduler::Stats MixScheduler::stats() const {
+    Stats s;
+    s.ticks = ticks_.load(std::memory_order_relaxed);
+    s.lateTicks = lateTicks_.load(std::memory_order_relaxed);
+    s.skippedTicks = skippedTicks_.load(std::memory_order_relaxed);
+    s.totalLatenessUs = totalLatenessUs_.load(std::memory_order_relaxed);
+    s.maxLatenessUs = maxLatenessUs_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void MixScheduler::addRoomInLoop(uint32_t roomId, int periodSteps, TimerCallback cb) {
+    loop_->assertInLoopThread();
+    if (rooms_.count(roomId)) {
+        LOGGER_WARN("MixScheduler: room {} is already scheduled", roomId);
+        return;
+    }
+
+    // Spread rooms evenly across the wheel: pick the offset whose
+    // busiest slot is the emptiest.
+    int offset = 0;
+    size_t bestLoad = SIZE_MAX;
+    for (int candidate = 0; candidate < periodSteps; ++candidate) {
+        size_t load = 0;
+        for (int phase = candidate; phase < kNumPhases; phase += periodSteps) {
+            load = std::max(load, phases_[phase].size());
+        }
+        if (load < bestLoad) {
+            bestLoad = load;
+            offset = candidate;
+        }
+    }
+
+    auto it = rooms_.emplace(roomId, Room{std::move(cb), periodSteps, offset}).first;
+    for (int phase = offset; phase < kNumPhases; phase += periodSteps) {
+        phases_[phase].push_back({roomId, &it->second.callback});
+    }
+    LOGGER_DEBUG("MixScheduler: room {} scheduled every {}ms from phase {} ({} rooms)",
+                 roomId, periodSteps * kStepMs, offset, phases_[offset].size());
+}
+
+void MixScheduler::removeRoomInLoop(uint32_t roomId) {
+    loop_->assertInLoopThread();
+    auto it = rooms_.find(roomId);
+    if (it == rooms_.end()) {
+        return;
+    }
+    const Room& room = it->second;
+    for (int phase = room.offset; phase < kNumPhases; phase += room.periodSteps) {
+        PhaseList& list = phases_[phase];
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [roomId](const Entry& e) { return e.roomId == roomId; }),
+                   list.end());
+    }
+    rooms_.erase(it);
+}
+
+void MixScheduler::handleRead() {
+#ifdef __linux__
+    loop_->assertInLoopThread();
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd_, &howmany, sizeof howmany);
+    if (n != sizeof howmany) {
+        LOGGER_ERROR("MixScheduler::handleRead() reads {} bytes instead of 8", n);
+    }
+
+    // The last tick whose deadline has already passed.
+    const int64_t dueTick = (monotonicNowNs() - epochNs_) / kPhaseStepNs;
+
+    // Replaying more than one default period would only mix stale audio;
+    // drop the excess and resume at the current phase.
+    constexpr int64_t kMaxCatchUpSteps = kDefaultPeriodMs / kStepMs;
+    if (dueTick - nextTick_ >= kMaxCatchUpSteps) {
+        int64_t skipped = dueTick - nextTick_ - kMaxCatchUpSteps + 1;
+        skippedTicks_.fetch_add(skipped, std::memory_order_relaxed);
+        nextTick_ += skipped;
+        LOGGER_WARN("MixScheduler fell behind, skipped {} phase batches", skipped);
+    }
+
+    while (nextTick_ <= dueTick) {
+        const int64_t latenessUs = (monotonicNowNs() - deadlineNs(nextTick_)) / 1000;
+        ticks_.fetch_add(1, std::memory_order_relaxed);
+        totalLatenessUs_.fetch_add(latenessUs, std::memory_order_relaxed);
+        if (latenessUs > maxLatenessUs_.load(std::memory_order_relaxed)) {
+            maxLatenessUs_.store(latenessUs, std::memory_order_relaxed);
+        }
+        if (latenessUs * 1000 > kPhaseStepNs) {
+            lateTicks_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        runPhase(static_cast<int>(nextTick_ % kNumPhases));
+        ++nextTick_;
+    }
+
+    armTimerfd();
+#endif
+}
+
+void MixScheduler::runPhase(int phase) {
+    for (const Entry& entry : phases_[phase]) {
+        (*entry.callback)();
+    }
+}
+
+void MixScheduler::armTimerfd() {
+#ifdef __linux__
+    const int64_t deadline = deadlineNs(nextTick_);
+    struct itimerspec newValue{};
+    newValue.it_value.tv_sec = static_cast<time_t>(deadline / (1000 * 1000 * 1000));
+    newValue.it_value.tv_nsec = static_cast<long>(deadline % (1000 * 1000 * 1000));
+    if (::timerfd_settime(timerfd_, TFD_TIMER_ABSTIME, &newValue, nullptr)) {
+        LOGGER_ERROR("MixScheduler: timerfd_settime() failed");
+    }
+#endif
+}
+
+} // namespace lightvoice